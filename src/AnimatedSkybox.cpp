@@ -0,0 +1,130 @@
+#include "AnimatedSkybox.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+static const std::string ANIMATED_FRAG = std::string("#version 330 core\n") + Space3d::FACE_DIRECTION_SOURCE + R"(
+uniform samplerCube uStars;
+uniform samplerCube uPrevious;
+uniform samplerCube uCurrent;
+uniform float uBlend;
+uniform int uFace;
+uniform float uSize;
+
+out vec4 fragmentColor;
+
+void main() {
+    vec3 dir = faceDirection(uFace, gl_FragCoord.xy / uSize * 2.0 - 1.0);
+    vec3 nebulas = mix(textureLod(uPrevious, dir, 0.0).rgb, textureLod(uCurrent, dir, 0.0).rgb, uBlend);
+    fragmentColor = vec4(textureLod(uStars, dir, 0.0).rgb + nebulas, 1.0);
+}
+)";
+
+Space3d::AnimatedSkybox::AnimatedSkybox(const Skybox& skybox, const int64_t seed, const int width,
+                                        const SkyboxParams& params, const int tileSize, const float timeStep,
+                                        const ProgramCache* cache)
+    : skybox(skybox), params(params), nebulas(Skybox::createLayout(seed, params)), width(width),
+      tileSize(std::min(tileSize, width)), tilesPerSide(0), timeStep(timeStep), keyframe(2), nextTile(0),
+      shader(FULLSCREEN_TRIANGLE_VERT, ANIMATED_FRAG, std::nullopt, cache) {
+
+    if (this->tileSize <= 0 || width % this->tileSize != 0) {
+        throw std::runtime_error("The width of an animated skybox must be a multiple of its tile size");
+    }
+    tilesPerSide = width / this->tileSize;
+
+    // The stars never change, they are rendered once without the nebulas.
+    auto layout = nebulas;
+    layout.nebulas.clear();
+    nebulas.stars.clear();
+
+    const auto fullTarget = [&](const Skybox::Result& cubemap) {
+        return Skybox::Target{GL_TEXTURE_CUBE_MAP, cubemap.get(), 0, 0, width};
+    };
+
+    stars.setStorage(width, 1, GL_RGB8);
+    skybox.generateTile(layout, Skybox::fullView(width), fullTarget(stars), params);
+
+    // The first two keyframes at once, the following ones are rendered tile by tile.
+    auto keyframeParams = params;
+    previous.setStorage(width, 1, GL_RGB8);
+    skybox.generateTile(nebulas, Skybox::fullView(width), fullTarget(previous), keyframeParams);
+    current.setStorage(width, 1, GL_RGB8);
+    keyframeParams.nebulaTime = params.nebulaTime + timeStep;
+    skybox.generateTile(nebulas, Skybox::fullView(width), fullTarget(current), keyframeParams);
+
+    next.setStorage(width, 1, GL_RGB8);
+    scratch.setTileStorage(this->tileSize, GL_RGB8);
+    result.setStorage(width, Skybox::Result::levelCount(width), GL_RGB8);
+
+    update(0);
+}
+
+float Space3d::AnimatedSkybox::getTime() const {
+    const float blend = static_cast<float>(nextTile) / static_cast<float>(6 * tilesPerSide * tilesPerSide);
+    return params.nebulaTime + (static_cast<float>(keyframe - 2) + blend) * timeStep;
+}
+
+void Space3d::AnimatedSkybox::renderTile() {
+    const auto face = static_cast<unsigned int>(nextTile / (tilesPerSide * tilesPerSide));
+    const int index = nextTile % (tilesPerSide * tilesPerSide);
+    const int x = (index % tilesPerSide) * tileSize;
+    const int y = (index / tilesPerSide) * tileSize;
+
+    auto keyframeParams = params;
+    keyframeParams.nebulaTime = params.nebulaTime + static_cast<float>(keyframe) * timeStep;
+    skybox.generateTile(nebulas, Skybox::tileView(face, x, y, tileSize, width),
+                        Skybox::Target{GL_TEXTURE_2D, scratch.get(), 0, 0, tileSize}, keyframeParams);
+
+    GlState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, read.get());
+    GlState::get().bindFramebuffer(GL_DRAW_FRAMEBUFFER, draw.get());
+    GlState::get().framebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scratch.get(), 0);
+    GlState::get().framebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                        GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, next.get(), 0);
+    glBlitFramebuffer(0, 0, tileSize, tileSize, x, y, x + tileSize, y + tileSize, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // A finished keyframe becomes the target of the cross-fade.
+    if (++nextTile == 6 * tilesPerSide * tilesPerSide) {
+        previous.swap(current);
+        current.swap(next);
+        nextTile = 0;
+        keyframe++;
+    }
+}
+
+void Space3d::AnimatedSkybox::update(const int tiles) {
+    for (int i = 0; i < tiles; i++) {
+        renderTile();
+    }
+
+    stars.bind(0);
+    previous.bind(1);
+    current.bind(2);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glDisable(GL_BLEND);
+
+    draw.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+    GlState::get().viewport(0, 0, width, width);
+
+    shader.use();
+    shader.setInt("uStars", 0);
+    shader.setInt("uPrevious", 1);
+    shader.setInt("uCurrent", 2);
+    shader.setFloat("uBlend", static_cast<float>(nextTile) / static_cast<float>(6 * tilesPerSide * tilesPerSide));
+    shader.setFloat("uSize", static_cast<float>(width));
+    vao.bind();
+    for (unsigned int i = 0; i < 6; i++) {
+        GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                                            result.get(), 0);
+        shader.setInt("uFace", static_cast<int>(i));
+        shader.drawArrays(GL_TRIANGLES, 3);
+    }
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_BLEND);
+    GlState::get().activeTexture(0);
+
+    skybox.generateMipmaps(result, params.mipFilter);
+}
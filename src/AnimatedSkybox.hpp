@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Shader.hpp"
+#include "Skybox.hpp"
+#include "Vao.hpp"
+
+namespace Space3d {
+// A skybox whose nebulas slowly evolve along the time axis of their noise. The
+// keyframes of the nebulas are rendered a few tiles per frame into a hidden cubemap
+// while the two previous keyframes are cross-faded, so the tiles never show up one
+// by one and every frame costs about the same. The stars are rendered once and
+// added on top of the nebulas.
+class AnimatedSkybox {
+public:
+    AnimatedSkybox(const Skybox& skybox, int64_t seed, int width, const SkyboxParams& params = SkyboxParams{},
+                   int tileSize = 256, float timeStep = 0.05f, const ProgramCache* cache = nullptr);
+
+    // Renders up to the given number of tiles of the next keyframe, then composites the
+    // stars and the cross-faded nebulas into the result and rebuilds its mipmaps.
+    void update(int tiles = 4);
+
+    const Skybox::Result& getResult() const {
+        return result;
+    }
+    // Noise time of the nebulas that are currently shown.
+    float getTime() const;
+
+private:
+    void renderTile();
+
+    const Skybox& skybox;
+    SkyboxParams params;
+    Skybox::Layout nebulas;
+    int width;
+    int tileSize;
+    int tilesPerSide;
+    float timeStep;
+
+    // The keyframe being rendered and its next tile, face major.
+    int keyframe;
+    int nextTile;
+
+    Skybox::Result stars;
+    // Shown as a blend from the first to the second keyframe by the progress of the third.
+    Skybox::Result previous;
+    Skybox::Result current;
+    Skybox::Result next;
+    Skybox::Result scratch;
+    Skybox::Result result;
+
+    Shader shader;
+    // Attribute-less fullscreen triangle.
+    Vao vao;
+    Fbo read;
+    Fbo draw;
+};
+} // namespace Space3d
@@ -0,0 +1,212 @@
+#include "Bake.hpp"
+#include "Context.hpp"
+#include "Irradiance.hpp"
+#include "MipChain.hpp"
+#include "Prefilter.hpp"
+#include "Process.hpp"
+#include "Readback.hpp"
+#include "Skybox.hpp"
+#include "TiledExport.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Writes the file next to its final path and renames it into place once it is complete.
+static void writeFile(const std::string& path, const std::function<void(std::ofstream& file)>& fn) {
+    const auto temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Failed to open file: " + temporary);
+        }
+        fn(file);
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + temporary);
+        }
+    }
+    fs::rename(temporary, path);
+}
+
+Space3d::Bake::Bake(const std::string& directory) : directory(directory), queue(directory) {
+}
+
+void Space3d::Bake::run(const std::string& executable, const BakeQueue::Settings& settings, const int processes) {
+    if (processes <= 0) {
+        throw std::runtime_error("Bake needs at least one worker process");
+    }
+    queue.prepare(settings);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 1;; round++) {
+        std::vector<Process> workers;
+        for (int i = 0; i < processes; i++) {
+            workers.emplace_back(std::vector<std::string>{executable, "--bake-worker", directory});
+        }
+
+        int failed = 0;
+        for (auto& worker : workers) {
+            if (worker.wait() != 0) {
+                failed++;
+            }
+        }
+
+        const auto progress = queue.getProgress();
+        if (progress.pending == 0 && progress.claimed == 0) {
+            break;
+        }
+        if (round == MAX_ROUNDS) {
+            throw std::runtime_error("Bake did not finish after " + std::to_string(MAX_ROUNDS) +
+                                     " rounds of workers, run it again to resume");
+        }
+
+        // Only a worker that died leaves its chunk claimed.
+        std::cerr << failed << " of " << processes << " workers failed, queueing "
+                  << queue.requeueClaimed() << " chunks again" << std::endl;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "Baked " << settings.count << " seeds in " << seconds << " s with " << processes
+              << " processes" << std::endl;
+}
+
+void Space3d::Bake::work() {
+    const auto settings = queue.readSettings();
+    const int width = settings.width;
+
+    // Only the cubemap is rendered, nothing that would wait for the GPU is computed. The lighting
+    // is computed on the CPU from the sky that was read back, while the GPU renders the next one.
+    auto params = SkyboxParams::fromQuality(settings.quality);
+    params.irradiance = false;
+    params.specularWidth = 0;
+    params.lightCount = 0;
+
+    Context context(64, 64, "Space 3D Bake", false);
+    Skybox skybox;
+    Readback readback(2);
+
+    // The files have no mipmaps, a single level is enough. The next sky is rendered into
+    // one target while the previous one is read back from the other.
+    std::array<Skybox::Result, 2> targets;
+    for (auto& target : targets) {
+        target.setStorage(width, 1, GL_RGB8);
+    }
+
+    struct Pending {
+        int64_t seed;
+        Readback::Ticket ticket;
+    };
+    std::deque<Pending> pending;
+
+    // The irradiance goes to "<seed>.sh", one "r g b" line per coefficient, and every level l of
+    // the specular cubemap to "<seed>-specular-<l>.s3dt". Both are written before the sky itself,
+    // a seed whose sky exists is complete.
+    const auto writeLighting = [&](const int64_t seed, MipChain::CpuLevel base) {
+        const auto levels = MipChain::generateCpu(std::move(base), params.mipFilter);
+
+        // A level of at most 128 texels is plenty for nine coefficients.
+        const auto small = std::find_if(levels.begin(), levels.end(),
+                                        [](const MipChain::CpuLevel& level) { return level.width <= 128; });
+        const auto irradiance = Irradiance::projectCpu(*small);
+        writeFile(queue.outputPath(seed, ".sh"), [&](std::ofstream& file) {
+            for (const auto& coefficient : irradiance) {
+                file << coefficient.x << " " << coefficient.y << " " << coefficient.z << "\n";
+            }
+        });
+
+        if (settings.specularWidth > 0) {
+            const int specularLevels =
+                std::min(params.specularLevels, Skybox::Result::levelCount(settings.specularWidth));
+            const auto specular =
+                Prefilter::generateCpu(levels, settings.specularWidth, specularLevels, params.specularSamples);
+            for (size_t l = 0; l < specular.size(); l++) {
+                const auto& level = specular[l];
+                writeFile(queue.outputPath(seed, "-specular-" + std::to_string(l) + ".s3dt"),
+                          [&](std::ofstream& file) {
+                              TiledExport::writeHeader(file, level.width, level.width);
+                              std::vector<uint8_t> rgb(static_cast<size_t>(level.width) * level.width * 3);
+                              for (const auto& face : level.faces) {
+                                  for (size_t i = 0; i < rgb.size() / 3; i++) {
+                                      for (size_t c = 0; c < 3; c++) {
+                                          const float value = std::min(std::max(face[i * 4 + c], 0.0f), 1.0f);
+                                          rgb[i * 3 + c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+                                      }
+                                  }
+                                  file.write(reinterpret_cast<const char*>(rgb.data()),
+                                             static_cast<std::streamsize>(rgb.size()));
+                              }
+                          });
+            }
+        }
+    };
+
+    const auto write = [&](const Pending& request) {
+        const auto path = queue.outputPath(request.seed);
+        const auto temporary = path + ".tmp";
+
+        // The rows of the read back faces are in texture order, the same as in the CPU levels.
+        MipChain::CpuLevel base;
+        base.width = width;
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Failed to open file: " + temporary);
+            }
+            TiledExport::writeHeader(file, width, width);
+            readback.read(request.ticket, [&](const std::vector<Readback::Image>& images) {
+                for (const auto& image : images) {
+                    file.write(reinterpret_cast<const char*>(image.data), static_cast<std::streamsize>(image.size));
+
+                    auto& face = base.faces[image.face];
+                    face.resize(static_cast<size_t>(width) * width * 4);
+                    for (size_t i = 0; i < face.size() / 4; i++) {
+                        for (size_t c = 0; c < 3; c++) {
+                            face[i * 4 + c] = static_cast<float>(image.data[i * 3 + c]) / 255.0f;
+                        }
+                        face[i * 4 + 3] = 1.0f;
+                    }
+                }
+            });
+            if (!file) {
+                throw std::runtime_error("Failed to write file: " + temporary);
+            }
+        }
+
+        writeLighting(request.seed, std::move(base));
+        fs::rename(temporary, path);
+    };
+
+    size_t index = 0;
+    while (const auto chunk = queue.claim()) {
+        for (int64_t seed = chunk->firstSeed; seed < chunk->firstSeed + chunk->count; seed++) {
+            // Baked before an earlier bake of this directory was interrupted.
+            if (fs::exists(queue.outputPath(seed))) {
+                continue;
+            }
+
+            const auto& target = targets[index++ % targets.size()];
+            skybox.generateInto(seed, Skybox::Target{GL_TEXTURE_CUBE_MAP, target.get(), 0, 0, width}, params);
+
+            if (pending.size() == targets.size()) {
+                write(pending.front());
+                pending.pop_front();
+            }
+            pending.push_back(Pending{seed, readback.request(target)});
+        }
+
+        while (!pending.empty()) {
+            write(pending.front());
+            pending.pop_front();
+        }
+        queue.complete(*chunk);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "BakeQueue.hpp"
+#include <string>
+
+namespace Space3d {
+// Bakes a range of seeds into one file per seed, in the format of TiledExport with a single tile
+// per face. Next to it go the irradiance of the sky and optionally its specular cubemap, both
+// computed on the CPU from the sky that was read back. A GL context scales poorly across threads,
+// so the work is spread over worker processes that each own a headless context and pull chunks
+// of seeds from a BakeQueue.
+//
+// A seed always produces the same sky, which makes the bake restartable at any point. A file is
+// only renamed into place once it is complete, and the seeds whose file exists are skipped.
+class Bake {
+public:
+    explicit Bake(const std::string& directory);
+
+    // Coordinator: prepares or resumes the queue, runs the workers and waits for them. The chunks
+    // of a worker that crashed are handed to a new round of workers, at most MAX_ROUNDS in total.
+    // The executable is started with "--bake-worker <directory>" for each worker.
+    void run(const std::string& executable, const BakeQueue::Settings& settings, int processes);
+
+    // Worker: claims chunks until the queue is empty. Needs no context, it creates its own.
+    void work();
+
+    static const int MAX_ROUNDS = 3;
+
+private:
+    std::string directory;
+    BakeQueue queue;
+};
+} // namespace Space3d
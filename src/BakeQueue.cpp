@@ -0,0 +1,173 @@
+#include "BakeQueue.hpp"
+#include "FileLock.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static const char* const QUEUE_DIR = "queue";
+static const char* const CLAIMED_DIR = "claimed";
+static const char* const DONE_DIR = "done";
+
+static size_t countFiles(const std::string& directory) {
+    return static_cast<size_t>(std::distance(fs::directory_iterator(directory), fs::directory_iterator()));
+}
+
+// Parses "<first seed>_<count>", the seed may be negative.
+static Space3d::BakeQueue::Chunk parseChunk(const std::string& name) {
+    const auto separator = name.rfind('_');
+    if (separator == std::string::npos || separator == 0) {
+        throw std::runtime_error("Unexpected file in the bake queue: " + name);
+    }
+    return Space3d::BakeQueue::Chunk{std::stoll(name.substr(0, separator)), std::stoll(name.substr(separator + 1))};
+}
+
+Space3d::BakeQueue::BakeQueue(std::string directory) : directory(std::move(directory)) {
+}
+
+void Space3d::BakeQueue::prepare(const Settings& settings) {
+    if (settings.count <= 0 || settings.chunkSize <= 0 || settings.width <= 0 || settings.specularWidth < 0) {
+        throw std::runtime_error("Bake needs a positive seed count, chunk size and width");
+    }
+
+    fs::create_directories(directory);
+    FileLock lock(path("queue.lock"));
+
+    if (fs::exists(path("manifest.txt"))) {
+        const auto existing = readSettings();
+        if (existing.firstSeed != settings.firstSeed || existing.count != settings.count ||
+            existing.width != settings.width || existing.quality != settings.quality ||
+            existing.chunkSize != settings.chunkSize || existing.specularWidth != settings.specularWidth) {
+            throw std::runtime_error("Directory holds a bake with different settings: " + directory);
+        }
+        for (const auto& entry : fs::directory_iterator(path(CLAIMED_DIR))) {
+            fs::rename(entry.path(), fs::path(path(QUEUE_DIR)) / entry.path().filename());
+        }
+        writeManifest(settings);
+        return;
+    }
+
+    // The manifest comes last, a directory without one was never fully set up and starts over.
+    fs::remove_all(path(QUEUE_DIR));
+    fs::remove_all(path(CLAIMED_DIR));
+    fs::remove_all(path(DONE_DIR));
+    fs::create_directories(path(QUEUE_DIR));
+    fs::create_directories(path(CLAIMED_DIR));
+    fs::create_directories(path(DONE_DIR));
+
+    for (int64_t offset = 0; offset < settings.count; offset += settings.chunkSize) {
+        const Chunk chunk{settings.firstSeed + offset, std::min(settings.chunkSize, settings.count - offset)};
+        std::ofstream file(fs::path(path(QUEUE_DIR)) / chunkName(chunk));
+        if (!file) {
+            throw std::runtime_error("Failed to create the bake queue in: " + directory);
+        }
+    }
+    writeManifest(settings);
+}
+
+size_t Space3d::BakeQueue::requeueClaimed() {
+    FileLock lock(path("queue.lock"));
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator(path(CLAIMED_DIR))) {
+        fs::rename(entry.path(), fs::path(path(QUEUE_DIR)) / entry.path().filename());
+        count++;
+    }
+    return count;
+}
+
+Space3d::BakeQueue::Settings Space3d::BakeQueue::readSettings() const {
+    std::ifstream file(path("manifest.txt"));
+    if (!file) {
+        throw std::runtime_error("No bake manifest in: " + directory);
+    }
+
+    std::map<std::string, std::string> values;
+    std::string key;
+    std::string value;
+    while (file >> key >> value) {
+        values[key] = value;
+    }
+
+    const auto get = [&](const std::string& name) -> const std::string& {
+        const auto it = values.find(name);
+        if (it == values.end()) {
+            throw std::runtime_error("Bake manifest is missing " + name + " in: " + directory);
+        }
+        return it->second;
+    };
+
+    // Manifests of bakes without specular cubemaps may not have the key.
+    const auto specular = values.find("specular_width");
+    return Settings{std::stoll(get("first_seed")), std::stoll(get("seed_count")), std::stoi(get("width")),
+                    SkyboxParams::parseQuality(get("quality")), std::stoll(get("chunk_size")),
+                    specular == values.end() ? 0 : std::stoi(specular->second)};
+}
+
+std::optional<Space3d::BakeQueue::Chunk> Space3d::BakeQueue::claim() {
+    FileLock lock(path("queue.lock"));
+
+    std::optional<Chunk> first;
+    for (const auto& entry : fs::directory_iterator(path(QUEUE_DIR))) {
+        const auto chunk = parseChunk(entry.path().filename().string());
+        if (!first || chunk.firstSeed < first->firstSeed) {
+            first = chunk;
+        }
+    }
+
+    if (first) {
+        fs::rename(fs::path(path(QUEUE_DIR)) / chunkName(*first), fs::path(path(CLAIMED_DIR)) / chunkName(*first));
+    }
+    return first;
+}
+
+void Space3d::BakeQueue::complete(const Chunk& chunk) {
+    FileLock lock(path("queue.lock"));
+    fs::rename(fs::path(path(CLAIMED_DIR)) / chunkName(chunk), fs::path(path(DONE_DIR)) / chunkName(chunk));
+    writeManifest(readSettings());
+}
+
+Space3d::BakeQueue::Progress Space3d::BakeQueue::getProgress() const {
+    FileLock lock(path("queue.lock"));
+    return Progress{countFiles(path(QUEUE_DIR)), countFiles(path(CLAIMED_DIR)), countFiles(path(DONE_DIR))};
+}
+
+std::string Space3d::BakeQueue::outputPath(const int64_t seed, const std::string& suffix) const {
+    return path(std::to_string(seed) + suffix);
+}
+
+std::string Space3d::BakeQueue::path(const std::string& name) const {
+    return (fs::path(directory) / name).string();
+}
+
+void Space3d::BakeQueue::writeManifest(const Settings& settings) const {
+    const auto done = countFiles(path(DONE_DIR));
+    const auto claimed = countFiles(path(CLAIMED_DIR));
+    const auto pending = countFiles(path(QUEUE_DIR));
+
+    // Written next to the old one and renamed over it, readers never see half of a manifest.
+    const auto temporary = path("manifest.txt.tmp");
+    {
+        std::ofstream file(temporary);
+        file << "first_seed " << settings.firstSeed << "\n";
+        file << "seed_count " << settings.count << "\n";
+        file << "width " << settings.width << "\n";
+        file << "quality " << SkyboxParams::toString(settings.quality) << "\n";
+        file << "chunk_size " << settings.chunkSize << "\n";
+        file << "specular_width " << settings.specularWidth << "\n";
+        file << "chunks_total " << done + claimed + pending << "\n";
+        file << "chunks_done " << done << "\n";
+        file << "chunks_claimed " << claimed << "\n";
+        file << "chunks_pending " << pending << "\n";
+        if (!file) {
+            throw std::runtime_error("Failed to write the bake manifest in: " + directory);
+        }
+    }
+    fs::rename(temporary, path("manifest.txt"));
+}
+
+std::string Space3d::BakeQueue::chunkName(const Chunk& chunk) {
+    return std::to_string(chunk.firstSeed) + "_" + std::to_string(chunk.count);
+}
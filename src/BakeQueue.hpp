@@ -0,0 +1,67 @@
+#pragma once
+
+#include "SkyboxParams.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace Space3d {
+// Work queue of a bake, shared by several processes through a directory. Every chunk of seeds
+// is an empty file named "<first seed>_<count>" that moves from queue/ to claimed/ to done/.
+// The moves and the manifest are guarded by an exclusive lock on the "queue.lock" file.
+//
+// The "manifest.txt" file holds the settings of the bake followed by the chunk counts, one
+// "key value" pair per line. It is rewritten whenever a chunk is done.
+class BakeQueue {
+public:
+    // What is baked. Stored in the manifest so that the workers and a resumed bake agree on it.
+    struct Settings {
+        int64_t firstSeed;
+        int64_t count;
+        int width;
+        SkyboxParams::Quality quality;
+        int64_t chunkSize;
+        // Width of the specular cubemap baked next to each sky, zero bakes none.
+        int specularWidth = 0;
+    };
+
+    struct Chunk {
+        int64_t firstSeed;
+        int64_t count;
+    };
+
+    // Number of chunks in each state.
+    struct Progress {
+        size_t pending;
+        size_t claimed;
+        size_t done;
+    };
+
+    explicit BakeQueue(std::string directory);
+
+    // Fills the queue with the chunks of a new bake. A directory that already holds a bake with
+    // the same settings is resumed instead, the chunks left claimed by dead workers are queued
+    // again. Throws for a bake with different settings. Only call while no worker is running.
+    void prepare(const Settings& settings);
+    // Puts the claimed chunks back into the queue, returns their number. Only call while no
+    // worker is running.
+    size_t requeueClaimed();
+    Settings readSettings() const;
+
+    // Takes the chunk with the lowest seed out of the queue, nothing once the queue is empty.
+    std::optional<Chunk> claim();
+    void complete(const Chunk& chunk);
+    Progress getProgress() const;
+
+    // The file the sky of the seed is baked into, or one of the files baked next to it.
+    std::string outputPath(int64_t seed, const std::string& suffix = ".s3dt") const;
+
+private:
+    std::string path(const std::string& name) const;
+    void writeManifest(const Settings& settings) const;
+
+    static std::string chunkName(const Chunk& chunk);
+
+    std::string directory;
+};
+} // namespace Space3d
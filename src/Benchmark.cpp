@@ -0,0 +1,61 @@
+#include "Benchmark.hpp"
+#include "Context.hpp"
+#include "GlState.hpp"
+#include "Skybox.hpp"
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+Space3d::Benchmark::Benchmark(const int width, const int iterations) : width(width), iterations(iterations) {
+    // Every average below is taken over the iterations.
+    if (iterations <= 0) {
+        throw std::runtime_error("The benchmark needs at least one iteration");
+    }
+}
+
+void Space3d::Benchmark::run(const std::vector<SkyboxParams::Quality>& qualities) {
+    Context context(64, 64, "Space 3D Benchmark", false);
+    Skybox skybox;
+
+    // The first generation includes driver warm up, it is not measured.
+    skybox.generate(0, width);
+    glFinish();
+
+    for (const auto quality : qualities) {
+        const auto params = SkyboxParams::fromQuality(quality);
+
+        double total = 0.0;
+        size_t layers = 0;
+        const size_t calls = GlState::get().getCalls();
+        const size_t skipped = GlState::get().getSkipped();
+        for (int i = 0; i < iterations; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto result = skybox.generate(i, width, params);
+            glFinish();
+            const auto end = std::chrono::steady_clock::now();
+
+            total += std::chrono::duration<double, std::milli>(end - start).count();
+            layers += Skybox::createLayout(i, params).nebulas.size();
+        }
+
+        std::cout << SkyboxParams::toString(quality) << ": " << width << "x" << width << " average "
+                  << total / iterations << " ms, " << static_cast<double>(layers) / iterations
+                  << " nebula layers on average" << std::endl;
+        const size_t issued = (GlState::get().getCalls() - calls) / iterations;
+        const size_t avoided = (GlState::get().getSkipped() - skipped) / iterations;
+        std::cout << "  " << avoided << " of " << issued + avoided << " state changes skipped per sky" << std::endl;
+
+        // The same seeds again, all of them rendered at once into one cubemap array.
+        if (GLAD_GL_VERSION_4_0 || GLAD_GL_ARB_texture_cube_map_array) {
+            std::vector<int64_t> seeds(static_cast<size_t>(iterations));
+            std::iota(seeds.begin(), seeds.end(), 0);
+            const auto start = std::chrono::steady_clock::now();
+            const auto batch = skybox.generateBatch(seeds, width, params);
+            glFinish();
+            const auto end = std::chrono::steady_clock::now();
+            std::cout << "  batched: " << std::chrono::duration<double, std::milli>(end - start).count() / iterations
+                      << " ms per sky" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "SkyboxParams.hpp"
+#include <vector>
+
+namespace Space3d {
+// Measures how long generating a skybox takes on each quality tier.
+class Benchmark {
+public:
+    Benchmark(int width, int iterations);
+
+    void run(const std::vector<SkyboxParams::Quality>& qualities);
+
+private:
+    int width;
+    int iterations;
+};
+} // namespace Space3d
@@ -0,0 +1,193 @@
+#include "BlockCompression.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPACE3D_SSE2
+#endif
+
+namespace {
+// The 16 pixels of a block as separate channels, so that four pixels fit into one SSE register.
+struct Block {
+    alignas(16) float r[16];
+    alignas(16) float g[16];
+    alignas(16) float b[16];
+};
+
+struct Color {
+    float r;
+    float g;
+    float b;
+};
+
+uint16_t toRgb565(const Color& c) {
+    const auto quantize = [](const float value, const int max) {
+        return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 255.0f) * max / 255.0f));
+    };
+    return static_cast<uint16_t>((quantize(c.r, 31) << 11) | (quantize(c.g, 63) << 5) | quantize(c.b, 31));
+}
+
+Color fromRgb565(const uint16_t value) {
+    const int r = (value >> 11) & 31;
+    const int g = (value >> 5) & 63;
+    const int b = value & 31;
+    return {static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)),
+            static_cast<float>((b << 3) | (b >> 2))};
+}
+
+// Picks the closest of the four palette colors for every pixel.
+void selectIndices(const Block& block, const Color (&palette)[4], uint32_t (&indices)[16]) {
+#ifdef SPACE3D_SSE2
+    for (int i = 0; i < 16; i += 4) {
+        const __m128 r = _mm_load_ps(block.r + i);
+        const __m128 g = _mm_load_ps(block.g + i);
+        const __m128 b = _mm_load_ps(block.b + i);
+
+        __m128 best = _mm_set1_ps(1.0e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int k = 0; k < 4; k++) {
+            const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k].r));
+            const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k].g));
+            const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k].b));
+            const __m128 dist =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+            const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+            best = _mm_min_ps(dist, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), bestIndex);
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        float best = 1.0e30f;
+        for (uint32_t k = 0; k < 4; k++) {
+            const float dr = block.r[i] - palette[k].r;
+            const float dg = block.g[i] - palette[k].g;
+            const float db = block.b[i] - palette[k].b;
+            const float dist = dr * dr + dg * dg + db * db;
+            if (dist < best) {
+                best = dist;
+                indices[i] = k;
+            }
+        }
+    }
+#endif
+}
+
+void encodeBlock(const Block& block, uint8_t* out) {
+    // The endpoints are picked along the principal axis of the block colors.
+    Color mean = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++) {
+        mean.r += block.r[i];
+        mean.g += block.g[i];
+        mean.b += block.b[i];
+    }
+    mean = {mean.r / 16.0f, mean.g / 16.0f, mean.b / 16.0f};
+
+    float cov[6] = {0.0f};
+    for (int i = 0; i < 16; i++) {
+        const float r = block.r[i] - mean.r;
+        const float g = block.g[i] - mean.g;
+        const float b = block.b[i] - mean.b;
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // A few power iterations are plenty for a 3x3 covariance matrix.
+    Color axis = {1.0f, 1.0f, 1.0f};
+    for (int i = 0; i < 4; i++) {
+        const Color next = {cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                            cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                            cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b};
+        const float length = std::sqrt(next.r * next.r + next.g * next.g + next.b * next.b);
+        if (length < 1.0e-6f) {
+            break;
+        }
+        axis = {next.r / length, next.g / length, next.b / length};
+    }
+
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        const float t =
+            (block.r[i] - mean.r) * axis.r + (block.g[i] - mean.g) * axis.g + (block.b[i] - mean.b) * axis.b;
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    // Insetting the endpoints slightly lowers the error of the interpolated colors.
+    const float inset = (maxT - minT) / 16.0f;
+    maxT -= inset;
+    minT += inset;
+
+    uint16_t c0 = toRgb565({mean.r + axis.r * maxT, mean.g + axis.g * maxT, mean.b + axis.b * maxT});
+    uint16_t c1 = toRgb565({mean.r + axis.r * minT, mean.g + axis.g * minT, mean.b + axis.b * minT});
+
+    // The four color mode requires c0 > c1, a solid block uses the first endpoint only.
+    uint32_t bits = 0;
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    if (c0 != c1) {
+        const Color e0 = fromRgb565(c0);
+        const Color e1 = fromRgb565(c1);
+        const Color palette[4] = {
+            e0,
+            e1,
+            {(2.0f * e0.r + e1.r) / 3.0f, (2.0f * e0.g + e1.g) / 3.0f, (2.0f * e0.b + e1.b) / 3.0f},
+            {(e0.r + 2.0f * e1.r) / 3.0f, (e0.g + 2.0f * e1.g) / 3.0f, (e0.b + 2.0f * e1.b) / 3.0f},
+        };
+
+        uint32_t indices[16];
+        selectIndices(block, palette, indices);
+        for (int i = 0; i < 16; i++) {
+            bits |= indices[i] << (2 * i);
+        }
+    }
+
+    out[0] = static_cast<uint8_t>(c0 & 0xff);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1 & 0xff);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = static_cast<uint8_t>((bits >> (8 * i)) & 0xff);
+    }
+}
+} // namespace
+
+size_t Space3d::bc1Size(const int width, const int height) {
+    return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * 8;
+}
+
+std::vector<uint8_t> Space3d::compressBc1(const uint8_t* rgb, const int width, const int height) {
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    std::vector<uint8_t> result(bc1Size(width, height));
+
+    parallelFor(static_cast<size_t>(blocksY), [&](const size_t begin, const size_t end) {
+        Block block;
+        for (auto by = static_cast<int>(begin); by < static_cast<int>(end); by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                for (int i = 0; i < 16; i++) {
+                    const int x = std::min(bx * 4 + i % 4, width - 1);
+                    const int y = std::min(by * 4 + i / 4, height - 1);
+                    const uint8_t* pixel = rgb + (static_cast<size_t>(y) * width + x) * 3;
+                    block.r[i] = pixel[0];
+                    block.g[i] = pixel[1];
+                    block.b[i] = pixel[2];
+                }
+                encodeBlock(block, result.data() + (static_cast<size_t>(by) * blocksX + bx) * 8);
+            }
+        }
+    });
+
+    return result;
+}
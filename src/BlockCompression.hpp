@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Space3d {
+// Size in bytes of a BC1 (DXT1) compressed image, 8 bytes per 4x4 block.
+size_t bc1Size(int width, int height);
+
+// Encodes a tightly packed RGB8 image into BC1 blocks. Rows of blocks are encoded
+// in parallel, images smaller than a block are padded by repeating the edge pixels.
+std::vector<uint8_t> compressBc1(const uint8_t* rgb, int width, int height);
+} // namespace Space3d
@@ -0,0 +1,49 @@
+// clang-format off
+#include <glad/glad.h> // Needs to be first
+#include "Context.hpp"
+#include "GlState.hpp"
+#include <iostream>
+#include <stdexcept>
+// clang-format on
+
+Space3d::Context::Context(const int width, const int height, const std::string& title, const bool visible)
+    : window(nullptr) {
+    glfwSetErrorCallback(errorCallback);
+
+    if (!glfwInit()) {
+        throw std::runtime_error("Failed to initialize glfw");
+    }
+
+    // Basic GLFW window stuff
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
+    window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        throw std::runtime_error("Failed to create glfw window");
+    }
+
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+
+    // Nothing of what was tracked for a previous context applies to this one.
+    GlState::get().reset();
+
+    // The skybox generator blends the stars and the nebulas.
+    glEnable(GL_BLEND);
+}
+
+Space3d::Context::~Context() {
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        GlState::get().reset();
+    }
+}
+
+void Space3d::Context::errorCallback(const int error, const char* description) {
+    std::cerr << "error: " << error << " description: " << description << std::endl;
+}
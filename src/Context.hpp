@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <string>
+
+namespace Space3d {
+// Owns a GLFW window with a current OpenGL 3.3 context. An invisible context is
+// used for generating skyboxes without displaying them.
+class Context {
+public:
+    Context(int width, int height, const std::string& title, bool visible);
+    Context(const Context& other) = delete;
+    ~Context();
+
+    Context& operator=(const Context& other) = delete;
+
+    GLFWwindow* get() const {
+        return window;
+    }
+
+private:
+    static void errorCallback(int error, const char* description);
+
+    GLFWwindow* window;
+};
+} // namespace Space3d
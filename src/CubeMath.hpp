@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+
+namespace Space3d {
+// Direction of the point (s, t) in [-1, 1] of a cubemap face, the inverse of cubeFace().
+// Faces are in the GL_TEXTURE_CUBE_MAP_POSITIVE_X order, t = -1 is the first row in memory.
+inline void faceDirection(const unsigned int face, const float s, const float t, float dir[3]) {
+    switch (face) {
+    case 0:
+        dir[0] = 1.0f, dir[1] = -t, dir[2] = -s;
+        break;
+    case 1:
+        dir[0] = -1.0f, dir[1] = -t, dir[2] = s;
+        break;
+    case 2:
+        dir[0] = s, dir[1] = 1.0f, dir[2] = t;
+        break;
+    case 3:
+        dir[0] = s, dir[1] = -1.0f, dir[2] = -t;
+        break;
+    case 4:
+        dir[0] = s, dir[1] = -t, dir[2] = 1.0f;
+        break;
+    default:
+        dir[0] = -s, dir[1] = -t, dir[2] = -1.0f;
+        break;
+    }
+}
+
+// The cubemap face selection of the GL specification, returns the face and (s, t) in [-1, 1].
+inline unsigned int cubeFace(const float dir[3], float& s, float& t) {
+    const float ax = std::abs(dir[0]);
+    const float ay = std::abs(dir[1]);
+    const float az = std::abs(dir[2]);
+    if (ax >= ay && ax >= az) {
+        s = (dir[0] > 0.0f ? -dir[2] : dir[2]) / ax;
+        t = -dir[1] / ax;
+        return dir[0] > 0.0f ? 0 : 1;
+    }
+    if (ay >= az) {
+        s = dir[0] / ay;
+        t = (dir[1] > 0.0f ? dir[2] : -dir[2]) / ay;
+        return dir[1] > 0.0f ? 2 : 3;
+    }
+    s = (dir[2] > 0.0f ? dir[0] : -dir[0]) / az;
+    t = -dir[1] / az;
+    return dir[2] > 0.0f ? 4 : 5;
+}
+
+// Solid angle of the part of a face between (0, 0) and (x, y).
+inline float faceAreaElement(const float x, const float y) {
+    return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+}
+
+// GLSL faceDirection(int face, vec2 st), the same as the one above for shaders that render
+// cubemap faces. Pasted after the #version line, like Skybox::octahedralSource().
+inline constexpr char FACE_DIRECTION_SOURCE[] = R"(
+vec3 faceDirection(int face, vec2 st) {
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+)";
+
+// Vertex shader of an attribute-less fullscreen triangle, drawn as three vertices.
+inline constexpr char FULLSCREEN_TRIANGLE_VERT[] = R"(#version 330 core
+void main() {
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+} // namespace Space3d
@@ -0,0 +1,31 @@
+#include "Fbo.hpp"
+#include "GlState.hpp"
+
+Space3d::Fbo::Fbo() : ref(0) {
+    glGenFramebuffers(1, &ref);
+}
+
+Space3d::Fbo::~Fbo() {
+    if (ref) {
+        GlState::get().deleteFramebuffer(ref);
+    }
+}
+
+void Space3d::Fbo::bind() const {
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, ref);
+}
+
+Space3d::Fbo::Fbo(Fbo&& other) noexcept : ref(0) {
+    swap(other);
+}
+
+void Space3d::Fbo::swap(Fbo& other) noexcept {
+    std::swap(ref, other.ref);
+}
+
+Space3d::Fbo& Space3d::Fbo::operator=(Fbo&& other) noexcept {
+    if (this != &other) {
+        swap(other);
+    }
+    return *this;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+
+namespace Space3d {
+class Fbo {
+public:
+    Fbo();
+    Fbo(const Fbo& other) = delete;
+    Fbo(Fbo&& other) noexcept;
+    ~Fbo();
+
+    void swap(Fbo& other) noexcept;
+    Fbo& operator=(const Fbo& other) = delete;
+    Fbo& operator=(Fbo&& other) noexcept;
+
+    void bind() const;
+
+    GLuint get() const {
+        return ref;
+    }
+
+private:
+    GLuint ref;
+};
+} // namespace Space3d
@@ -0,0 +1,55 @@
+#include "FileLock.hpp"
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+Space3d::FileLock::FileLock(const std::string& path) : handle(nullptr) {
+    const auto file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open lock file: " + path);
+    }
+
+    OVERLAPPED overlapped = {};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to lock file: " + path);
+    }
+    handle = file;
+}
+
+Space3d::FileLock::~FileLock() {
+    OVERLAPPED overlapped = {};
+    UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+    CloseHandle(handle);
+}
+#else
+Space3d::FileLock::FileLock(const std::string& path) : fd(-1) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open lock file: " + path);
+    }
+
+    // A signal may interrupt the wait, flock() is simply retried then.
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            close(fd);
+            throw std::runtime_error("Failed to lock file: " + path);
+        }
+    }
+}
+
+Space3d::FileLock::~FileLock() {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+#endif
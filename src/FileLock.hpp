@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+namespace Space3d {
+// Exclusive lock on a file shared by several processes, held for the lifetime of the object.
+// The operating system releases it when the process dies, so a crash never leaves it locked.
+class FileLock {
+public:
+    // Creates the file if needed and blocks until the lock is acquired.
+    explicit FileLock(const std::string& path);
+    FileLock(const FileLock& other) = delete;
+    ~FileLock();
+
+    FileLock& operator=(const FileLock& other) = delete;
+
+private:
+#ifdef _WIN32
+    void* handle;
+#else
+    int fd;
+#endif
+};
+} // namespace Space3d
@@ -0,0 +1,209 @@
+#include "GlState.hpp"
+#include <algorithm>
+#include <iterator>
+
+// Marks state that is not known, nothing is skipped until it was set once.
+static const GLuint UNKNOWN = ~0u;
+
+// Layer values of the attachments that are not a single layer.
+static const GLint NO_LAYER = -1;
+static const GLint ALL_LAYERS = -2;
+
+bool Space3d::GlState::Attachment::operator==(const Attachment& other) const {
+    return textureTarget == other.textureTarget && texture == other.texture && level == other.level &&
+           layer == other.layer;
+}
+
+Space3d::GlState& Space3d::GlState::get() {
+    static thread_local GlState state;
+    return state;
+}
+
+Space3d::GlState::GlState() {
+    reset();
+}
+
+void Space3d::GlState::reset() {
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    readFramebuffer = UNKNOWN;
+    drawFramebuffer = UNKNOWN;
+    unit = UNKNOWN;
+    std::fill(std::begin(viewportRect), std::end(viewportRect), -1);
+    blend[0] = UNKNOWN;
+    blend[1] = UNKNOWN;
+    buffers.clear();
+    textures.clear();
+    attachments.clear();
+    calls = 0;
+    skipped = 0;
+}
+
+bool Space3d::GlState::update(GLuint& current, const GLuint value) {
+    if (current == value) {
+        skipped++;
+        return false;
+    }
+    current = value;
+    calls++;
+    return true;
+}
+
+void Space3d::GlState::useProgram(const GLuint program) {
+    if (update(this->program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void Space3d::GlState::bindVertexArray(const GLuint vao) {
+    if (update(this->vao, vao)) {
+        glBindVertexArray(vao);
+    }
+}
+
+void Space3d::GlState::bindBuffer(const GLenum target, const GLuint buffer) {
+    auto it = buffers.emplace(target, UNKNOWN).first;
+    if (update(it->second, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void Space3d::GlState::bindFramebuffer(const GLenum target, const GLuint framebuffer) {
+    if (target == GL_FRAMEBUFFER) {
+        if (readFramebuffer == framebuffer && drawFramebuffer == framebuffer) {
+            skipped++;
+            return;
+        }
+        readFramebuffer = framebuffer;
+        drawFramebuffer = framebuffer;
+        calls++;
+        glBindFramebuffer(target, framebuffer);
+    } else if (update(target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer, framebuffer)) {
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+void Space3d::GlState::attach(const GLenum target, const GLenum attachment, const Attachment& value) {
+    // Only the attachments of the framebuffer objects are remembered, not knowing which
+    // one is bound means not knowing anything.
+    const GLuint framebuffer = target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+    if (framebuffer != UNKNOWN && framebuffer != 0) {
+        auto it = attachments.find({framebuffer, attachment});
+        if (it != attachments.end() && it->second == value) {
+            skipped++;
+            return;
+        }
+        attachments[{framebuffer, attachment}] = value;
+    }
+    calls++;
+
+    if (value.layer == ALL_LAYERS) {
+        glFramebufferTexture(target, attachment, value.texture, value.level);
+    } else if (value.layer == NO_LAYER) {
+        glFramebufferTexture2D(target, attachment, value.textureTarget, value.texture, value.level);
+    } else {
+        glFramebufferTextureLayer(target, attachment, value.texture, value.level, value.layer);
+    }
+}
+
+void Space3d::GlState::framebufferTexture2D(const GLenum target, const GLenum attachment, const GLenum textureTarget,
+                                            const GLuint texture, const GLint level) {
+    attach(target, attachment, Attachment{textureTarget, texture, level, NO_LAYER});
+}
+
+void Space3d::GlState::framebufferTextureLayer(const GLenum target, const GLenum attachment, const GLuint texture,
+                                               const GLint level, const GLint layer) {
+    attach(target, attachment, Attachment{0, texture, level, layer});
+}
+
+void Space3d::GlState::framebufferTexture(const GLenum target, const GLenum attachment, const GLuint texture,
+                                          const GLint level) {
+    attach(target, attachment, Attachment{0, texture, level, ALL_LAYERS});
+}
+
+void Space3d::GlState::activeTexture(const GLuint unit) {
+    if (update(this->unit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void Space3d::GlState::bindTexture(const GLuint unit, const GLenum target, const GLuint texture) {
+    activeTexture(unit);
+    auto it = textures.emplace(std::make_pair(unit, target), UNKNOWN).first;
+    if (update(it->second, texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void Space3d::GlState::viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height) {
+    if (viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height) {
+        skipped++;
+        return;
+    }
+    viewportRect[0] = x;
+    viewportRect[1] = y;
+    viewportRect[2] = width;
+    viewportRect[3] = height;
+    calls++;
+    glViewport(x, y, width, height);
+}
+
+void Space3d::GlState::blendFunc(const GLenum source, const GLenum destination) {
+    if (blend[0] == source && blend[1] == destination) {
+        skipped++;
+        return;
+    }
+    blend[0] = source;
+    blend[1] = destination;
+    calls++;
+    glBlendFunc(source, destination);
+}
+
+void Space3d::GlState::deleteProgram(const GLuint program) {
+    // A program in use is only deleted once it is no longer in use.
+    if (this->program == program) {
+        this->program = UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void Space3d::GlState::deleteVertexArray(const GLuint vao) {
+    if (this->vao == vao) {
+        this->vao = 0;
+    }
+    glDeleteVertexArrays(1, &vao);
+}
+
+void Space3d::GlState::deleteBuffer(const GLuint buffer) {
+    for (auto& binding : buffers) {
+        if (binding.second == buffer) {
+            binding.second = 0;
+        }
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void Space3d::GlState::deleteFramebuffer(const GLuint framebuffer) {
+    if (readFramebuffer == framebuffer) {
+        readFramebuffer = 0;
+    }
+    if (drawFramebuffer == framebuffer) {
+        drawFramebuffer = 0;
+    }
+    for (auto it = attachments.begin(); it != attachments.end();) {
+        it = it->first.first == framebuffer ? attachments.erase(it) : std::next(it);
+    }
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+void Space3d::GlState::deleteTexture(const GLuint texture) {
+    for (auto& binding : textures) {
+        if (binding.second == texture) {
+            binding.second = 0;
+        }
+    }
+    for (auto it = attachments.begin(); it != attachments.end();) {
+        it = it->second.texture == texture ? attachments.erase(it) : std::next(it);
+    }
+    glDeleteTextures(1, &texture);
+}
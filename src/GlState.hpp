@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <map>
+#include <utility>
+
+namespace Space3d {
+// Remembers the OpenGL state that is set through it and skips the calls that would set
+// a value that is already there. The skipping is only correct when every change of the
+// tracked state goes through here, the wrappers and the generator do that. There is one
+// instance per thread, as a context is current on one thread, Context resets it.
+class GlState {
+public:
+    static GlState& get();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // GL_FRAMEBUFFER binds both the read and the draw framebuffer.
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    // The attachments are remembered per framebuffer, switching between framebuffers keeps them.
+    void framebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level);
+    void framebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer);
+    // Attaches all layers of the texture for layered rendering.
+    void framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level);
+    void activeTexture(GLuint unit);
+    // Also leaves the unit active.
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void blendFunc(GLenum source, GLenum destination);
+
+    // Deletes the object and forgets where it was bound, OpenGL reuses the names.
+    void deleteProgram(GLuint program);
+    void deleteVertexArray(GLuint vao);
+    void deleteBuffer(GLuint buffer);
+    void deleteFramebuffer(GLuint framebuffer);
+    void deleteTexture(GLuint texture);
+
+    // Forgets all state, for a new context or after the state was changed directly.
+    void reset();
+
+    // State changes that reached the driver and the ones that were skipped since the last reset.
+    size_t getCalls() const {
+        return calls;
+    }
+    size_t getSkipped() const {
+        return skipped;
+    }
+
+private:
+    struct Attachment {
+        GLenum textureTarget;
+        GLuint texture;
+        GLint level;
+        GLint layer;
+
+        bool operator==(const Attachment& other) const;
+    };
+
+    GlState();
+
+    // Counts the call, returns false if the value is already set.
+    bool update(GLuint& current, GLuint value);
+    void attach(GLenum target, GLenum attachment, const Attachment& value);
+
+    GLuint program;
+    GLuint vao;
+    GLuint readFramebuffer;
+    GLuint drawFramebuffer;
+    GLuint unit;
+    GLint viewportRect[4];
+    GLenum blend[2];
+    std::map<GLenum, GLuint> buffers;
+    std::map<std::pair<GLuint, GLenum>, GLuint> textures;
+    std::map<std::pair<GLuint, GLenum>, Attachment> attachments;
+    size_t calls;
+    size_t skipped;
+};
+} // namespace Space3d
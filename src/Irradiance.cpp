@@ -0,0 +1,267 @@
+#include "Irradiance.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPACE3D_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const std::string IRRADIANCE_FRAG = std::string("#version 330 core\n") + Space3d::FACE_DIRECTION_SOURCE + R"(
+uniform samplerCube uSource;
+uniform float uLevel;
+uniform int uFace;
+uniform float uSize;
+
+layout(location = 0) out vec4 out0;
+layout(location = 1) out vec4 out1;
+layout(location = 2) out vec4 out2;
+layout(location = 3) out vec4 out3;
+layout(location = 4) out vec4 out4;
+layout(location = 5) out vec4 out5;
+layout(location = 6) out vec4 out6;
+
+float areaElement(float x, float y) {
+    return atan(x * y, sqrt(x * x + y * y + 1.0));
+}
+
+void main() {
+    vec2 st0 = floor(gl_FragCoord.xy) / uSize * 2.0 - 1.0;
+    vec2 st1 = st0 + 2.0 / uSize;
+    float solidAngle = areaElement(st0.x, st0.y) - areaElement(st0.x, st1.y) - areaElement(st1.x, st0.y) +
+                       areaElement(st1.x, st1.y);
+
+    vec3 dir = normalize(faceDirection(uFace, (st0 + st1) * 0.5));
+    vec3 c = textureLod(uSource, dir, uLevel).rgb * solidAngle;
+
+    float x = dir.x;
+    float y = dir.y;
+    float z = dir.z;
+    vec3 sh0 = c * 0.282095;
+    vec3 sh1 = c * 0.488603 * y;
+    vec3 sh2 = c * 0.488603 * z;
+    vec3 sh3 = c * 0.488603 * x;
+    vec3 sh4 = c * 1.092548 * x * y;
+    vec3 sh5 = c * 1.092548 * y * z;
+    vec3 sh6 = c * 0.315392 * (3.0 * z * z - 1.0);
+    vec3 sh7 = c * 1.092548 * x * z;
+    vec3 sh8 = c * 0.546274 * (x * x - y * y);
+
+    out0 = vec4(sh0, sh1.r);
+    out1 = vec4(sh1.gb, sh2.rg);
+    out2 = vec4(sh2.b, sh3);
+    out3 = vec4(sh4, sh5.r);
+    out4 = vec4(sh5.gb, sh6.rg);
+    out5 = vec4(sh6.b, sh7);
+    out6 = vec4(sh8, 0.0);
+}
+)";
+
+// The cubemap is resampled to this size per face before the reduction.
+static const int REDUCTION_SIZE = 32;
+static const int REDUCTION_LEVELS = 6;
+
+static void shBasis(const float dir[3], float basis[9]) {
+    const float x = dir[0];
+    const float y = dir[1];
+    const float z = dir[2];
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * y;
+    basis[2] = 0.488603f * z;
+    basis[3] = 0.488603f * x;
+    basis[4] = 1.092548f * x * y;
+    basis[5] = 1.092548f * y * z;
+    basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+    basis[7] = 1.092548f * x * z;
+    basis[8] = 0.546274f * (x * x - y * y);
+}
+
+Space3d::Irradiance::Irradiance(const ProgramCache* cache)
+    : shader(FULLSCREEN_TRIANGLE_VERT, IRRADIANCE_FRAG, std::nullopt, cache), targets{} {
+
+    glGenTextures(static_cast<GLsizei>(targets.size()), targets.data());
+    for (const auto target : targets) {
+        GlState::get().bindTexture(0, GL_TEXTURE_2D, target);
+        for (int level = 0; level < REDUCTION_LEVELS; level++) {
+            const int size = REDUCTION_SIZE >> level;
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, REDUCTION_LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    fbo.bind();
+    for (size_t i = 0; i < targets.size(); i++) {
+        GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i),
+                                            GL_TEXTURE_2D, targets[i], 0);
+    }
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+Space3d::Irradiance::~Irradiance() {
+    if (targets[0]) {
+        for (const auto target : targets) {
+            GlState::get().deleteTexture(target);
+        }
+    }
+}
+
+Space3d::ShCoefficients Space3d::Irradiance::project(const GLuint cubemap, const int width, const int levels) const {
+    // The smallest level that is still at least as detailed as the reduction grid.
+    int level = 0;
+    while (level + 1 < levels && (width >> (level + 1)) >= REDUCTION_SIZE) {
+        level++;
+    }
+
+    GlState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    fbo.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2,
+                                         GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5,
+                                         GL_COLOR_ATTACHMENT6};
+    glDrawBuffers(static_cast<GLsizei>(targets.size()), drawBuffers);
+    GlState::get().viewport(0, 0, REDUCTION_SIZE, REDUCTION_SIZE);
+
+    const float zero[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (size_t i = 0; i < targets.size(); i++) {
+        glClearBufferfv(GL_COLOR, static_cast<GLint>(i), zero);
+    }
+
+    // The six faces are summed per texel by the blending.
+    glEnable(GL_BLEND);
+    GlState::get().blendFunc(GL_ONE, GL_ONE);
+    glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+
+    shader.use();
+    shader.setInt("uSource", 0);
+    shader.setFloat("uLevel", static_cast<float>(level));
+    shader.setFloat("uSize", static_cast<float>(REDUCTION_SIZE));
+    vao.bind();
+    for (int face = 0; face < 6; face++) {
+        shader.setInt("uFace", face);
+        shader.drawArrays(GL_TRIANGLES, 3);
+    }
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The last mip level is the average of all texels.
+    std::array<float, 28> sums{};
+    const float texels = static_cast<float>(REDUCTION_SIZE * REDUCTION_SIZE);
+    for (size_t i = 0; i < targets.size(); i++) {
+        GlState::get().bindTexture(0, GL_TEXTURE_2D, targets[i]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glGetTexImage(GL_TEXTURE_2D, REDUCTION_LEVELS - 1, GL_RGBA, GL_FLOAT, &sums[i * 4]);
+    }
+
+    ShCoefficients sh;
+    for (size_t k = 0; k < sh.size(); k++) {
+        sh[k] = glm::vec3{sums[k * 3 + 0], sums[k * 3 + 1], sums[k * 3 + 2]} * texels;
+    }
+    return sh;
+}
+
+Space3d::ShCoefficients Space3d::Irradiance::projectCpu(const MipChain::CpuLevel& level) {
+    const int width = level.width;
+    std::array<float, 9 * 4> total{};
+    std::mutex mutex;
+
+    parallelFor(static_cast<size_t>(6 * width), [&](const size_t begin, const size_t end) {
+        // Each chunk sums into its own registers and merges once at the end.
+#ifdef SPACE3D_SSE2
+        __m128 acc[9];
+        for (auto& value : acc) {
+            value = _mm_setzero_ps();
+        }
+#else
+        std::array<float, 9 * 4> acc{};
+#endif
+        for (size_t row = begin; row < end; row++) {
+            const auto face = static_cast<unsigned int>(row / width);
+            const int y = static_cast<int>(row % width);
+            const float t0 = static_cast<float>(y) / width * 2.0f - 1.0f;
+            const float t1 = t0 + 2.0f / width;
+            const float* texels = &level.faces[face][static_cast<size_t>(y) * width * 4];
+
+            for (int x = 0; x < width; x++) {
+                const float s0 = static_cast<float>(x) / width * 2.0f - 1.0f;
+                const float s1 = s0 + 2.0f / width;
+                const float solidAngle = faceAreaElement(s0, t0) - faceAreaElement(s0, t1) -
+                                         faceAreaElement(s1, t0) + faceAreaElement(s1, t1);
+
+                float dir[3];
+                faceDirection(face, (s0 + s1) * 0.5f, (t0 + t1) * 0.5f, dir);
+                const float length = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+                for (auto& d : dir) {
+                    d /= length;
+                }
+
+                float basis[9];
+                shBasis(dir, basis);
+#ifdef SPACE3D_SSE2
+                const __m128 color = _mm_mul_ps(_mm_loadu_ps(&texels[x * 4]), _mm_set1_ps(solidAngle));
+                for (size_t k = 0; k < 9; k++) {
+                    acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(color, _mm_set1_ps(basis[k])));
+                }
+#else
+                for (size_t k = 0; k < 9; k++) {
+                    for (size_t c = 0; c < 4; c++) {
+                        acc[k * 4 + c] += texels[x * 4 + c] * solidAngle * basis[k];
+                    }
+                }
+#endif
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t k = 0; k < 9; k++) {
+#ifdef SPACE3D_SSE2
+            float values[4];
+            _mm_storeu_ps(values, acc[k]);
+#else
+            const float* values = &acc[k * 4];
+#endif
+            for (size_t c = 0; c < 4; c++) {
+                total[k * 4 + c] += values[c];
+            }
+        }
+    });
+
+    ShCoefficients sh;
+    for (size_t k = 0; k < sh.size(); k++) {
+        sh[k] = glm::vec3{total[k * 4 + 0], total[k * 4 + 1], total[k * 4 + 2]};
+    }
+    return sh;
+}
+
+glm::vec3 Space3d::Irradiance::evaluate(const ShCoefficients& sh, const glm::vec3& normal) {
+    // The clamped cosine lobe scales each band of the radiance (Ramamoorthi and Hanrahan).
+    static const float bands[9] = {static_cast<float>(M_PI),
+                                   static_cast<float>(2.0 * M_PI / 3.0),
+                                   static_cast<float>(2.0 * M_PI / 3.0),
+                                   static_cast<float>(2.0 * M_PI / 3.0),
+                                   static_cast<float>(M_PI / 4.0),
+                                   static_cast<float>(M_PI / 4.0),
+                                   static_cast<float>(M_PI / 4.0),
+                                   static_cast<float>(M_PI / 4.0),
+                                   static_cast<float>(M_PI / 4.0)};
+
+    const float dir[3] = {normal.x, normal.y, normal.z};
+    float basis[9];
+    shBasis(dir, basis);
+
+    glm::vec3 result{0.0f};
+    for (size_t k = 0; k < sh.size(); k++) {
+        result += sh[k] * (bands[k] * basis[k]);
+    }
+    return result;
+}
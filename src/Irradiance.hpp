@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "MipChain.hpp"
+#include "Shader.hpp"
+#include "Vao.hpp"
+#include <array>
+#include <glm/vec3.hpp>
+
+namespace Space3d {
+// L2 spherical harmonics projection of the sky radiance, nine RGB coefficients in
+// the order (0,0), (1,-1), (1,0), (1,1), (2,-2), (2,-1), (2,0), (2,1), (2,2).
+using ShCoefficients = std::array<glm::vec3, 9>;
+
+// Projects a cubemap onto the L2 spherical harmonics. Every texel is weighted by
+// the solid angle it covers, texels at the face corners cover less of the sphere.
+class Irradiance {
+public:
+    explicit Irradiance(const ProgramCache* cache = nullptr);
+    Irradiance(const Irradiance& other) = delete;
+    ~Irradiance();
+
+    Irradiance& operator=(const Irradiance& other) = delete;
+
+    // The cubemap must have its mip chain, a level close to the reduction size is
+    // resampled and summed by averaging mipmaps of float render targets.
+    ShCoefficients project(GLuint cubemap, int width, int levels) const;
+
+    // The same on the CPU, on all hardware threads.
+    static ShCoefficients projectCpu(const MipChain::CpuLevel& level);
+
+    // Irradiance arriving at a surface with the given normal, divide by pi for the
+    // outgoing radiance of a white lambertian surface.
+    static glm::vec3 evaluate(const ShCoefficients& sh, const glm::vec3& normal);
+
+private:
+    Shader shader;
+    Vao vao;
+    Fbo fbo;
+    // 27 floats per texel, spread over the RGBA channels of seven targets.
+    std::array<GLuint, 7> targets;
+};
+} // namespace Space3d
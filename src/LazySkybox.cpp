@@ -0,0 +1,66 @@
+#include "LazySkybox.hpp"
+#include "GlState.hpp"
+#include <glm/geometric.hpp>
+
+// Directions of the cubemap faces in the GL_TEXTURE_CUBE_MAP_POSITIVE_X order.
+static const std::array<glm::vec3, 6> FACE_DIRECTIONS = {
+    glm::vec3{1.0f, 0.0f, 0.0f},  glm::vec3{-1.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f},
+    glm::vec3{0.0f, -1.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 1.0f},  glm::vec3{0.0f, 0.0f, -1.0f}};
+
+Space3d::LazySkybox::LazySkybox(const Skybox& skybox, const int64_t seed, const int width,
+                                const SkyboxParams& params, const int placeholderWidth)
+    : skybox(skybox), params(params), layout(Skybox::createLayout(seed, params)), done{}, remaining(6) {
+
+    // Only a few milliseconds, the whole sky is visible from the first frame.
+    auto placeholderParams = params;
+    placeholderParams.compression = SkyboxParams::Compression::None;
+    // The faces of the placeholder are blitted into the faces of the result.
+    placeholderParams.mapping = SkyboxParams::Mapping::Cubemap;
+    // Only the faces are used, the lighting of the placeholder would be thrown away.
+    placeholderParams.irradiance = false;
+    placeholderParams.lightCount = 0;
+    placeholderParams.specularWidth = 0;
+    const auto placeholder = skybox.generate(seed, placeholderWidth, placeholderParams);
+
+    result.setStorage(width, Skybox::Result::levelCount(width), GL_RGB8);
+
+    Fbo read;
+    Fbo draw;
+    GlState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, read.get());
+    GlState::get().bindFramebuffer(GL_DRAW_FRAMEBUFFER, draw.get());
+    for (unsigned int i = 0; i < 6; i++) {
+        GlState::get().framebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, placeholder.get(), 0);
+        GlState::get().framebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, result.get(), 0);
+        glBlitFramebuffer(0, 0, placeholderWidth, placeholderWidth, 0, 0, width, width, GL_COLOR_BUFFER_BIT,
+                          GL_LINEAR);
+    }
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    skybox.generateMipmaps(result, params.mipFilter);
+}
+
+bool Space3d::LazySkybox::update(const glm::vec3& forward, const int faces) {
+    for (int n = 0; n < faces && remaining > 0; n++) {
+        // The face closest to the view direction covers most of the screen.
+        int best = -1;
+        for (int i = 0; i < 6; i++) {
+            if (!done[i] && (best < 0 || glm::dot(forward, FACE_DIRECTIONS[i]) >
+                                             glm::dot(forward, FACE_DIRECTIONS[best]))) {
+                best = i;
+            }
+        }
+
+        const auto face = static_cast<unsigned int>(best);
+        const int width = result.getWidth();
+        skybox.generateTile(layout, Skybox::tileView(face, 0, 0, width, width),
+                            Skybox::Target{GL_TEXTURE_CUBE_MAP, result.get(), 0, 0, width}, params);
+        done[face] = true;
+        remaining--;
+
+        // The lower levels still hold the placeholder for this face.
+        skybox.generateMipmaps(result, params.mipFilter);
+    }
+    return isComplete();
+}
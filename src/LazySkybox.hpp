@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Skybox.hpp"
+#include <array>
+#include <glm/vec3.hpp>
+
+namespace Space3d {
+// Shows a new skybox right away and refines it over the next frames. A tiny cubemap
+// is generated first and upscaled into all faces of the full resolution one, then
+// the faces are replaced by full resolution renders one at a time, the ones the
+// camera looks at first. The result is always a cubemap, the mapping parameter is
+// ignored.
+class LazySkybox {
+public:
+    LazySkybox(const Skybox& skybox, int64_t seed, int width, const SkyboxParams& params = SkyboxParams{},
+               int placeholderWidth = 32);
+
+    // Renders up to the given number of missing faces, ordered by how much they face
+    // the camera direction. Returns true once all faces are at full resolution.
+    bool update(const glm::vec3& forward, int faces = 1);
+
+    bool isComplete() const {
+        return remaining == 0;
+    }
+    const Skybox::Result& getResult() const {
+        return result;
+    }
+
+private:
+    const Skybox& skybox;
+    SkyboxParams params;
+    Skybox::Layout layout;
+    Skybox::Result result;
+    std::array<bool, 6> done;
+    int remaining;
+};
+} // namespace Space3d
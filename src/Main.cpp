@@ -0,0 +1,168 @@
+#include "Bake.hpp"
+#include "Benchmark.hpp"
+#include "Context.hpp"
+#include "Parallel.hpp"
+#include "SeedSearch.hpp"
+#include "TiledExport.hpp"
+#include "Window.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage(const char* name) {
+    std::cout << "usage: " << name << " [--quality low|medium|high|ultra] [--virtual <width>] [--lazy] [--animated]"
+              << " [--octahedral] [--seed <seed>]" << std::endl;
+    std::cout << "       " << name << " --benchmark [width] [iterations]" << std::endl;
+    std::cout << "       " << name << " --export <file> <width> [tile size] [seed]" << std::endl;
+    std::cout << "       " << name
+              << " --bake <directory> <first seed> <count> [width] [processes] [chunk size] [quality] [specular width]"
+              << std::endl;
+    std::cout << "       " << name << " --search <first seed> <count> [--layers <min> <max>] [--coverage <min> <max>]"
+              << " [--brightness <min> <max>] [--color <r> <g> <b> <distance>] [--width <width>]" << std::endl;
+}
+
+int main(const int argc, char** argv) {
+    using namespace Space3d;
+    try {
+        if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0) {
+            const int width = argc > 2 ? std::stoi(argv[2]) : 1024;
+            const int iterations = argc > 3 ? std::stoi(argv[3]) : 10;
+            Benchmark benchmark(width, iterations);
+            benchmark.run({SkyboxParams::Quality::Low, SkyboxParams::Quality::Medium, SkyboxParams::Quality::High,
+                           SkyboxParams::Quality::Ultra});
+            return EXIT_SUCCESS;
+        }
+
+        if (argc > 3 && std::strcmp(argv[1], "--export") == 0) {
+            const int width = std::stoi(argv[3]);
+            const int tileSize = argc > 4 ? std::stoi(argv[4]) : 1024;
+            const int64_t seed = argc > 5 ? std::stoll(argv[5]) : 12345;
+            Context context(64, 64, "Space 3D Export", false);
+            Skybox skybox;
+            TiledExport exporter(skybox, tileSize);
+            exporter.run(seed, width, argv[2]);
+            return EXIT_SUCCESS;
+        }
+
+        if (argc > 4 && std::strcmp(argv[1], "--bake") == 0) {
+            BakeQueue::Settings settings;
+            settings.firstSeed = std::stoll(argv[3]);
+            settings.count = std::stoll(argv[4]);
+            settings.width = argc > 5 ? std::stoi(argv[5]) : 1024;
+            const int processes = argc > 6 ? std::stoi(argv[6]) : static_cast<int>(hardwareThreads());
+            settings.chunkSize = argc > 7 ? std::stoll(argv[7]) : 16;
+            settings.quality = argc > 8 ? SkyboxParams::parseQuality(argv[8]) : SkyboxParams::Quality::High;
+            settings.specularWidth = argc > 9 ? std::stoi(argv[9]) : 0;
+            Bake bake(argv[2]);
+            bake.run(argv[0], settings, processes);
+            return EXIT_SUCCESS;
+        }
+
+        if (argc > 2 && std::strcmp(argv[1], "--bake-worker") == 0) {
+            Bake bake(argv[2]);
+            bake.work();
+            return EXIT_SUCCESS;
+        }
+
+        if (argc > 3 && std::strcmp(argv[1], "--search") == 0) {
+            const int64_t first = std::stoll(argv[2]);
+            const int64_t count = std::stoll(argv[3]);
+
+            // Every criterion is a range the stats have to be in, all of them must match.
+            int width = 16;
+            std::vector<SeedSearch::Predicate> criteria;
+            for (int i = 4; i < argc; i++) {
+                if (i + 2 < argc && std::strcmp(argv[i], "--layers") == 0) {
+                    const int min = std::stoi(argv[i + 1]);
+                    const int max = std::stoi(argv[i + 2]);
+                    criteria.emplace_back(
+                        [=](const SeedSearch::Stats& s) { return s.layers >= min && s.layers <= max; });
+                    i += 2;
+                } else if (i + 2 < argc && std::strcmp(argv[i], "--coverage") == 0) {
+                    const float min = std::stof(argv[i + 1]);
+                    const float max = std::stof(argv[i + 2]);
+                    criteria.emplace_back(
+                        [=](const SeedSearch::Stats& s) { return s.coverage >= min && s.coverage <= max; });
+                    i += 2;
+                } else if (i + 2 < argc && std::strcmp(argv[i], "--brightness") == 0) {
+                    const float min = std::stof(argv[i + 1]);
+                    const float max = std::stof(argv[i + 2]);
+                    criteria.emplace_back(
+                        [=](const SeedSearch::Stats& s) { return s.brightness >= min && s.brightness <= max; });
+                    i += 2;
+                } else if (i + 4 < argc && std::strcmp(argv[i], "--color") == 0) {
+                    const glm::vec3 color{std::stof(argv[i + 1]), std::stof(argv[i + 2]), std::stof(argv[i + 3])};
+                    const float distance = std::stof(argv[i + 4]);
+                    criteria.emplace_back([=](const SeedSearch::Stats& s) {
+                        return SeedSearch::colorDistance(s.meanColor, color) <= distance;
+                    });
+                    i += 4;
+                } else if (i + 1 < argc && std::strcmp(argv[i], "--width") == 0) {
+                    width = std::stoi(argv[++i]);
+                } else {
+                    printUsage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            const SeedSearch search(SkyboxParams{}, width);
+            const auto start = std::chrono::steady_clock::now();
+            const auto matches = search.search(first, count, [&](const SeedSearch::Stats& s) {
+                return std::all_of(criteria.begin(), criteria.end(), [&](const auto& c) { return c(s); });
+            });
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << std::fixed << std::setprecision(3);
+            for (const auto& s : matches) {
+                std::cout << s.seed << ": layers " << s.layers << ", coverage " << s.coverage << ", brightness "
+                          << s.brightness << ", color " << s.meanColor.x << " " << s.meanColor.y << " "
+                          << s.meanColor.z << std::endl;
+            }
+            std::cout << matches.size() << " of " << count << " seeds match, "
+                      << static_cast<double>(count) / elapsed.count() << " seeds per second" << std::endl;
+            std::cout << "View one with --seed <seed>, or render it with --export" << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        auto quality = SkyboxParams::Quality::High;
+        int virtualWidth = 0;
+        bool lazy = false;
+        bool animated = false;
+        bool octahedral = false;
+        int64_t seed = 12345;
+        for (int i = 1; i < argc; i++) {
+            if (i + 1 < argc && std::strcmp(argv[i], "--quality") == 0) {
+                quality = SkyboxParams::parseQuality(argv[++i]);
+            } else if (i + 1 < argc && std::strcmp(argv[i], "--virtual") == 0) {
+                virtualWidth = std::stoi(argv[++i]);
+            } else if (std::strcmp(argv[i], "--lazy") == 0) {
+                lazy = true;
+            } else if (std::strcmp(argv[i], "--animated") == 0) {
+                animated = true;
+            } else if (std::strcmp(argv[i], "--octahedral") == 0) {
+                octahedral = true;
+            } else if (i + 1 < argc && std::strcmp(argv[i], "--seed") == 0) {
+                seed = std::stoll(argv[++i]);
+            } else {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto params = SkyboxParams::fromQuality(quality);
+        if (octahedral) {
+            params.mapping = SkyboxParams::Mapping::Octahedral;
+        }
+        Window window(params, virtualWidth, lazy, animated, seed);
+        window.run();
+        return EXIT_SUCCESS;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
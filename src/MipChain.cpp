@@ -0,0 +1,321 @@
+#include "MipChain.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPACE3D_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// The #version line is prepended, CUBE_ARRAY reads one cubemap of a cubemap array.
+static const std::string MIP_CHAIN_FRAG = std::string(Space3d::FACE_DIRECTION_SOURCE) + R"(
+#ifdef CUBE_ARRAY
+uniform samplerCubeArray uSource;
+uniform float uLayer;
+#define SAMPLE_SOURCE(dir) textureLod(uSource, vec4(dir, uLayer), 0.0)
+#else
+uniform samplerCube uSource;
+#define SAMPLE_SOURCE(dir) textureLod(uSource, dir, 0.0)
+#endif
+uniform int uFace;
+uniform float uSourceWidth;
+uniform int uTaps;
+uniform float uWeights[8];
+
+out vec4 fragmentColor;
+
+void main() {
+    // The destination texel covers 2x2 source texels, the taps land on source texel centers.
+    vec2 center = floor(gl_FragCoord.xy) * 2.0 + 1.0;
+    vec3 color = vec3(0.0);
+    for (int y = 0; y < uTaps; y++) {
+        for (int x = 0; x < uTaps; x++) {
+            vec2 texel = center + vec2(float(x), float(y)) - float(uTaps) * 0.5 + 0.5;
+            // Taps outside of the face continue on the neighbouring face.
+            vec3 dir = faceDirection(uFace, texel / uSourceWidth * 2.0 - 1.0);
+            color += uWeights[x] * uWeights[y] * SAMPLE_SOURCE(dir).rgb;
+        }
+    }
+    fragmentColor = vec4(max(color, 0.0), 1.0);
+}
+)";
+
+// The Kaiser windowed sinc spans this many source texels per axis.
+static const int KAISER_TAPS = 6;
+static const double KAISER_ALPHA = 4.0;
+// Rows of the base level reduced together by one task of the pipelined box filter.
+static const int BOX_BAND_ROWS = 32;
+
+#ifdef SPACE3D_SSE2
+using Texel = __m128;
+
+static inline Texel texelZero() {
+    return _mm_setzero_ps();
+}
+static inline Texel texelLoad(const float* src) {
+    return _mm_loadu_ps(src);
+}
+static inline Texel texelMadd(const Texel acc, const Texel value, const float weight) {
+    return _mm_add_ps(acc, _mm_mul_ps(value, _mm_set1_ps(weight)));
+}
+static inline void texelStore(float* dst, const Texel value) {
+    _mm_storeu_ps(dst, _mm_max_ps(value, _mm_setzero_ps()));
+}
+#else
+struct Texel {
+    float v[4];
+};
+
+static inline Texel texelZero() {
+    return Texel{{0.0f, 0.0f, 0.0f, 0.0f}};
+}
+static inline Texel texelLoad(const float* src) {
+    return Texel{{src[0], src[1], src[2], src[3]}};
+}
+static inline Texel texelMadd(Texel acc, const Texel value, const float weight) {
+    for (int i = 0; i < 4; i++) {
+        acc.v[i] += value.v[i] * weight;
+    }
+    return acc;
+}
+static inline void texelStore(float* dst, const Texel value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = std::max(value.v[i], 0.0f);
+    }
+}
+#endif
+
+// Zeroth order modified Bessel function of the first kind.
+static double besselI0(const double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Bilinear sample of the texel coordinates (x, y) of a face, texel centers at + 0.5.
+static Texel sampleBilinear(const Space3d::MipChain::CpuLevel& level, const unsigned int face, const float x,
+                            const float y) {
+    const int width = level.width;
+    const float fx = std::min(std::max(x - 0.5f, 0.0f), static_cast<float>(width - 1));
+    const float fy = std::min(std::max(y - 0.5f, 0.0f), static_cast<float>(width - 1));
+    const int x0 = static_cast<int>(fx);
+    const int y0 = static_cast<int>(fy);
+    const int x1 = std::min(x0 + 1, width - 1);
+    const int y1 = std::min(y0 + 1, width - 1);
+    const float wx = fx - static_cast<float>(x0);
+    const float wy = fy - static_cast<float>(y0);
+
+    const float* texels = level.faces[face].data();
+    Texel result = texelZero();
+    result = texelMadd(result, texelLoad(&texels[(y0 * width + x0) * 4]), (1.0f - wx) * (1.0f - wy));
+    result = texelMadd(result, texelLoad(&texels[(y0 * width + x1) * 4]), wx * (1.0f - wy));
+    result = texelMadd(result, texelLoad(&texels[(y1 * width + x0) * 4]), (1.0f - wx) * wy);
+    result = texelMadd(result, texelLoad(&texels[(y1 * width + x1) * 4]), wx * wy);
+    return result;
+}
+
+// Filters the rows [rowBegin, rowEnd) of a face of the destination level.
+static void filterRows(const Space3d::MipChain::CpuLevel& src, Space3d::MipChain::CpuLevel& dst,
+                       const unsigned int face, const int rowBegin, const int rowEnd,
+                       const std::vector<float>& weights) {
+    const int taps = static_cast<int>(weights.size());
+    const int srcWidth = src.width;
+    const float* srcTexels = src.faces[face].data();
+    float* dstTexels = dst.faces[face].data();
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        for (int x = 0; x < dst.width; x++) {
+            Texel acc = texelZero();
+            for (int ty = 0; ty < taps; ty++) {
+                const int sy = 2 * y + 1 + ty - taps / 2;
+                for (int tx = 0; tx < taps; tx++) {
+                    const int sx = 2 * x + 1 + tx - taps / 2;
+                    const float weight = weights[ty] * weights[tx];
+
+                    if (sx >= 0 && sy >= 0 && sx < srcWidth && sy < srcWidth) {
+                        acc = texelMadd(acc, texelLoad(&srcTexels[(sy * srcWidth + sx) * 4]), weight);
+                    } else {
+                        // The tap continues on the neighbouring face.
+                        float dir[3];
+                        float s, t;
+                        Space3d::faceDirection(face, (static_cast<float>(sx) + 0.5f) / srcWidth * 2.0f - 1.0f,
+                                               (static_cast<float>(sy) + 0.5f) / srcWidth * 2.0f - 1.0f, dir);
+                        const auto other = Space3d::cubeFace(dir, s, t);
+                        acc = texelMadd(acc,
+                                        sampleBilinear(src, other, (s + 1.0f) * 0.5f * srcWidth,
+                                                       (t + 1.0f) * 0.5f * srcWidth),
+                                        weight);
+                    }
+                }
+            }
+            texelStore(&dstTexels[(y * dst.width + x) * 4], acc);
+        }
+    }
+}
+
+Space3d::MipChain::MipChain(const ProgramCache* cache)
+    : shader(FULLSCREEN_TRIANGLE_VERT, "#version 330 core\n" + MIP_CHAIN_FRAG, std::nullopt, cache) {
+    if (GLAD_GL_VERSION_4_0 || GLAD_GL_ARB_texture_cube_map_array) {
+        const std::string version = GLAD_GL_VERSION_4_0
+                                        ? "#version 400 core\n"
+                                        : "#version 330 core\n#extension GL_ARB_texture_cube_map_array : require\n";
+        arrayShader = std::make_unique<Shader>(FULLSCREEN_TRIANGLE_VERT,
+                                               version + "#define CUBE_ARRAY\n" + MIP_CHAIN_FRAG, std::nullopt, cache);
+    }
+}
+
+std::vector<float> Space3d::MipChain::weights(const SkyboxParams::MipFilter filter) {
+    if (filter == SkyboxParams::MipFilter::Box) {
+        return {0.5f, 0.5f};
+    }
+
+    std::vector<float> result(KAISER_TAPS);
+    const double radius = KAISER_TAPS * 0.5;
+    double sum = 0.0;
+    for (int i = 0; i < KAISER_TAPS; i++) {
+        // Distance in source texels, the cutoff is at half of the source resolution.
+        const double x = i - radius + 0.5;
+        const double r = x / radius;
+        const double window = besselI0(M_PI * KAISER_ALPHA * std::sqrt(std::max(1.0 - r * r, 0.0))) /
+                              besselI0(M_PI * KAISER_ALPHA);
+        const double sinc = std::sin(M_PI * x * 0.5) / (M_PI * x * 0.5);
+        result[i] = static_cast<float>(window * sinc);
+        sum += result[i];
+    }
+    for (auto& weight : result) {
+        weight = static_cast<float>(weight / sum);
+    }
+    return result;
+}
+
+void Space3d::MipChain::generate(const GLuint cubemap, const int width, const int levels,
+                                 const SkyboxParams::MipFilter filter, const int layers) const {
+    if (layers > 0 && !arrayShader) {
+        throw std::runtime_error("Cubemap arrays are not supported by the driver");
+    }
+    const auto kernel = weights(filter);
+    const GLenum target = layers > 0 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+    const Shader& shader = layers > 0 ? *arrayShader : this->shader;
+
+    GlState::get().bindTexture(0, target, cubemap);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glDisable(GL_BLEND);
+
+    fbo.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+
+    shader.use();
+    shader.setInt("uSource", 0);
+    shader.setInt("uTaps", static_cast<int>(kernel.size()));
+    shader.setFloatArray("uWeights", kernel.data(), static_cast<GLsizei>(kernel.size()));
+    vao.bind();
+
+    for (int level = 1; level < levels; level++) {
+        // Only the source level is visible to the sampler, the rendered one must not be.
+        glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level - 1);
+
+        const int size = std::max(width >> level, 1);
+        GlState::get().viewport(0, 0, size, size);
+        shader.setFloat("uSourceWidth", static_cast<float>(std::max(width >> (level - 1), 1)));
+
+        if (layers == 0) {
+            for (unsigned int i = 0; i < 6; i++) {
+                GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                                    GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemap, level);
+                shader.setInt("uFace", static_cast<int>(i));
+                shader.drawArrays(GL_TRIANGLES, 3);
+            }
+            continue;
+        }
+
+        // The layer-faces of an array are ordered by cubemap first, then by face.
+        for (int layer = 0; layer < layers; layer++) {
+            shader.setFloat("uLayer", static_cast<float>(layer));
+            for (int i = 0; i < 6; i++) {
+                GlState::get().framebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cubemap, level,
+                                                       layer * 6 + i);
+                shader.setInt("uFace", i);
+                shader.drawArrays(GL_TRIANGLES, 3);
+            }
+        }
+    }
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_BLEND);
+
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+std::vector<Space3d::MipChain::CpuLevel> Space3d::MipChain::generateCpu(CpuLevel base,
+                                                                       const SkyboxParams::MipFilter filter) {
+    const auto kernel = weights(filter);
+
+    std::vector<CpuLevel> levels;
+    levels.push_back(std::move(base));
+    while (levels.back().width > 1) {
+        CpuLevel level;
+        level.width = levels.back().width / 2;
+        for (auto& face : level.faces) {
+            face.resize(static_cast<size_t>(level.width) * level.width * 4);
+        }
+        levels.push_back(std::move(level));
+    }
+
+    // The box filter never leaves the face and a destination row only needs two source
+    // rows. A band of base rows is reduced through all levels it still has rows in,
+    // independently of the other bands. The bands must cover the whole face, other widths
+    // take the level by level path below.
+    size_t next = 1;
+    const int baseWidth = levels.front().width;
+    if (filter == SkyboxParams::MipFilter::Box && baseWidth >= BOX_BAND_ROWS && baseWidth % BOX_BAND_ROWS == 0) {
+        size_t bandLevels = 0;
+        while ((BOX_BAND_ROWS >> (bandLevels + 1)) > 0 && bandLevels + 1 < levels.size()) {
+            bandLevels++;
+        }
+
+        const size_t bands = static_cast<size_t>(baseWidth / BOX_BAND_ROWS);
+        parallelFor(6 * bands, [&](const size_t begin, const size_t end) {
+            for (size_t task = begin; task < end; task++) {
+                const auto face = static_cast<unsigned int>(task / bands);
+                const int band = static_cast<int>(task % bands);
+                for (size_t l = 1; l <= bandLevels; l++) {
+                    const int rows = BOX_BAND_ROWS >> l;
+                    filterRows(levels[l - 1], levels[l], face, band * rows, (band + 1) * rows, kernel);
+                }
+            }
+        });
+        next = bandLevels + 1;
+    }
+
+    // Level by level, every destination row of all faces is a separate task.
+    for (size_t l = next; l < levels.size(); l++) {
+        const int rows = levels[l].width;
+        parallelFor(static_cast<size_t>(6 * rows), [&](const size_t begin, const size_t end) {
+            for (size_t task = begin; task < end; task++) {
+                const auto face = static_cast<unsigned int>(task / rows);
+                const int row = static_cast<int>(task % rows);
+                filterRows(levels[l - 1], levels[l], face, row, row + 1, kernel);
+            }
+        });
+    }
+
+    return levels;
+}
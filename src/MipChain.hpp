@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Shader.hpp"
+#include "SkyboxParams.hpp"
+#include "Vao.hpp"
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Space3d {
+// Builds the mip chain of a cubemap. Unlike glGenerateMipmap the filter taps are
+// placed by direction, so a kernel wider than 2x2 continues on the neighbouring
+// face instead of clamping at the face edge.
+class MipChain {
+public:
+    // RGBA float texels of the six faces of one level, rows ordered as in a texture.
+    struct CpuLevel {
+        int width;
+        std::array<std::vector<float>, 6> faces;
+    };
+
+    explicit MipChain(const ProgramCache* cache = nullptr);
+
+    // Fills the levels 1 to levels - 1 of the cubemap from its level 0. With layers above zero
+    // the texture is a cubemap array of that many cubemaps and all of them are filled.
+    void generate(GLuint cubemap, int width, int levels, SkyboxParams::MipFilter filter, int layers = 0) const;
+
+    // The same on the CPU for headless bakes, returns all levels down to 1x1 with the base
+    // first. Uses all hardware threads, with the box filter each band of rows is reduced
+    // through several levels without waiting for the rest of the face.
+    static std::vector<CpuLevel> generateCpu(CpuLevel base, SkyboxParams::MipFilter filter);
+
+    // The separable 1D weights of the kernel, centered between two source texels.
+    static std::vector<float> weights(SkyboxParams::MipFilter filter);
+
+private:
+    Shader shader;
+    // Null when the driver has no cubemap arrays.
+    std::unique_ptr<Shader> arrayShader;
+    // Attribute-less fullscreen triangle.
+    Vao vao;
+    Fbo fbo;
+};
+} // namespace Space3d
@@ -0,0 +1,109 @@
+#include "Noise.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+// Port of the GLSL textureless classic 4D noise by Stefan Gustavson, see the nebula shader.
+// Copyright (c) 2011 Stefan Gustavson. All rights reserved.
+// Distributed under the MIT license. See LICENSE file.
+// https://github.com/ashima/webgl-noise
+
+static glm::vec4 mod289(const glm::vec4& x) {
+    return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+}
+
+static glm::vec4 permute(const glm::vec4& x) {
+    return mod289((x * 34.0f + 1.0f) * x);
+}
+
+static float taylorInvSqrt(const float r) {
+    return 1.79284291400159f - 0.85373472095314f * r;
+}
+
+static glm::vec4 fade(const glm::vec4& t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// The four gradients of one slice of the lattice, as the columns gx, gy, gz and gw.
+static void gradients(const glm::vec4& ixy, glm::vec4 g[4]) {
+    glm::vec4 gx = ixy * (1.0f / 7.0f);
+    glm::vec4 gy = glm::floor(gx) * (1.0f / 7.0f);
+    glm::vec4 gz = glm::floor(gy) * (1.0f / 6.0f);
+    gx = glm::fract(gx) - 0.5f;
+    gy = glm::fract(gy) - 0.5f;
+    gz = glm::fract(gz) - 0.5f;
+    const glm::vec4 gw = glm::vec4(0.75f) - glm::abs(gx) - glm::abs(gy) - glm::abs(gz);
+    const glm::vec4 sw = glm::step(gw, glm::vec4(0.0f));
+    gx -= sw * (glm::step(glm::vec4(0.0f), gx) - 0.5f);
+    gy -= sw * (glm::step(glm::vec4(0.0f), gy) - 0.5f);
+
+    for (int i = 0; i < 4; i++) {
+        g[i] = glm::vec4{gx[i], gy[i], gz[i], gw[i]};
+    }
+}
+
+float Space3d::cnoise(const glm::vec4& p) {
+    glm::vec4 pi0 = glm::floor(p);
+    glm::vec4 pi1 = pi0 + 1.0f;
+    pi0 = mod289(pi0);
+    pi1 = mod289(pi1);
+    const glm::vec4 pf0 = glm::fract(p);
+    const glm::vec4 pf1 = pf0 - 1.0f;
+    const glm::vec4 ix{pi0.x, pi1.x, pi0.x, pi1.x};
+    const glm::vec4 iy{pi0.y, pi0.y, pi1.y, pi1.y};
+
+    const glm::vec4 ixy = permute(permute(ix) + iy);
+    const glm::vec4 ixy0 = permute(ixy + pi0.z);
+    const glm::vec4 ixy1 = permute(ixy + pi1.z);
+
+    // g[z][w][corner], the corners of a slice in the order 00, 10, 01, 11 of x and y.
+    glm::vec4 g[2][2][4];
+    gradients(permute(ixy0 + pi0.w), g[0][0]);
+    gradients(permute(ixy0 + pi1.w), g[0][1]);
+    gradients(permute(ixy1 + pi0.w), g[1][0]);
+    gradients(permute(ixy1 + pi1.w), g[1][1]);
+
+    float n[2][2][4];
+    for (int z = 0; z < 2; z++) {
+        for (int w = 0; w < 2; w++) {
+            for (int corner = 0; corner < 4; corner++) {
+                auto& gradient = g[z][w][corner];
+                gradient *= taylorInvSqrt(glm::dot(gradient, gradient));
+                const glm::vec4 offset{(corner & 1) ? pf1.x : pf0.x, (corner & 2) ? pf1.y : pf0.y,
+                                       z ? pf1.z : pf0.z, w ? pf1.w : pf0.w};
+                n[z][w][corner] = glm::dot(gradient, offset);
+            }
+        }
+    }
+
+    const glm::vec4 f = fade(pf0);
+    const glm::vec4 n0w = glm::mix(glm::vec4{n[0][0][0], n[0][0][1], n[0][0][2], n[0][0][3]},
+                                   glm::vec4{n[0][1][0], n[0][1][1], n[0][1][2], n[0][1][3]}, f.w);
+    const glm::vec4 n1w = glm::mix(glm::vec4{n[1][0][0], n[1][0][1], n[1][0][2], n[1][0][3]},
+                                   glm::vec4{n[1][1][0], n[1][1][1], n[1][1][2], n[1][1][3]}, f.w);
+    const glm::vec4 nzw = glm::mix(n0w, n1w, f.z);
+    const float ny0 = glm::mix(nzw.x, nzw.z, f.y);
+    const float ny1 = glm::mix(nzw.y, nzw.w, f.y);
+    return 2.2f * glm::mix(ny0, ny1, f.x);
+}
+
+float Space3d::nebulaNoise(const glm::vec3& p, const float time) {
+    return 0.5f * cnoise(glm::vec4(p, time)) + 0.5f;
+}
+
+float Space3d::nebulaDensity(const glm::vec3& p, const float octaves, const float time) {
+    // Same loop as displacement() of the shader, from the finest octave down to the first.
+    glm::vec3 displace(0.0f);
+    for (int i = 10; i >= 1; i--) {
+        const float weight = std::min(std::max(octaves - static_cast<float>(i) + 1.0f, 0.0f), 1.0f);
+        if (weight > 0.0f) {
+            const float scale = std::exp2(static_cast<float>(i));
+            const glm::vec3 octave{nebulaNoise(p * scale + displace, time),
+                                   nebulaNoise(glm::vec3{p.y, p.z, p.x} * scale + displace, time),
+                                   nebulaNoise(glm::vec3{p.z, p.x, p.y} * scale + displace, time)};
+            displace = glm::mix(displace, octave, weight);
+        }
+    }
+    return nebulaNoise(p + displace, time);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace Space3d {
+// CPU versions of the noise functions of the nebula shader. They return the same values up to
+// float rounding, so the sky can be reasoned about without rendering it.
+
+// Classic 4D Perlin noise by Stefan Gustavson, roughly in [-1, 1].
+float cnoise(const glm::vec4& p);
+
+// Nebula noise in [0, 1], the fourth axis of the noise is the time.
+float nebulaNoise(const glm::vec3& p, float time);
+
+// Domain warped nebula noise of the shader, a fractional octave count blends the finest octave in.
+float nebulaDensity(const glm::vec3& p, float octaves, float time);
+} // namespace Space3d
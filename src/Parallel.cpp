@@ -0,0 +1,50 @@
+#include "Parallel.hpp"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+size_t Space3d::hardwareThreads() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void Space3d::parallelFor(const size_t count, const std::function<void(size_t begin, size_t end)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    const auto threads = std::min(hardwareThreads(), count);
+    if (threads == 1) {
+        fn(0, count);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+
+    const auto chunk = (count + threads - 1) / threads;
+    const auto work = [&](const size_t begin) {
+        try {
+            fn(begin, std::min(begin + chunk, count));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+    };
+
+    // The calling thread takes the first chunk.
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        workers.emplace_back(work, begin);
+    }
+    work(0);
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace Space3d {
+// Splits the range [0, count) into contiguous chunks and runs them on all hardware threads.
+// Returns once every chunk is done, exceptions from the chunks are rethrown.
+void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& fn);
+
+size_t hardwareThreads();
+} // namespace Space3d
@@ -0,0 +1,38 @@
+#include "Pbo.hpp"
+#include "GlState.hpp"
+
+Space3d::Pbo::Pbo() : ref(0), size(0) {
+    glGenBuffers(1, &ref);
+}
+
+Space3d::Pbo::~Pbo() {
+    if (ref) {
+        GlState::get().deleteBuffer(ref);
+    }
+}
+
+void Space3d::Pbo::allocate(const size_t size) {
+    this->size = size;
+    GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, ref);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+}
+
+void Space3d::Pbo::bind() const {
+    GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, ref);
+}
+
+Space3d::Pbo::Pbo(Pbo&& other) noexcept : ref(0), size(0) {
+    swap(other);
+}
+
+void Space3d::Pbo::swap(Pbo& other) noexcept {
+    std::swap(ref, other.ref);
+    std::swap(size, other.size);
+}
+
+Space3d::Pbo& Space3d::Pbo::operator=(Pbo&& other) noexcept {
+    if (this != &other) {
+        swap(other);
+    }
+    return *this;
+}
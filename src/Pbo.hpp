@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+
+namespace Space3d {
+// Pixel pack buffer, the target of asynchronous glReadPixels calls.
+class Pbo {
+public:
+    Pbo();
+    Pbo(const Pbo& other) = delete;
+    Pbo(Pbo&& other) noexcept;
+    ~Pbo();
+
+    void swap(Pbo& other) noexcept;
+    Pbo& operator=(const Pbo& other) = delete;
+    Pbo& operator=(Pbo&& other) noexcept;
+
+    void allocate(const size_t size);
+    void bind() const;
+
+    GLuint get() const {
+        return ref;
+    }
+    size_t getSize() const {
+        return size;
+    }
+
+private:
+    GLuint ref;
+    size_t size;
+};
+} // namespace Space3d
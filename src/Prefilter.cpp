@@ -0,0 +1,266 @@
+#include "Prefilter.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <stdexcept>
+#include <string>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const std::string PREFILTER_FRAG = std::string("#version 330 core\n") + Space3d::FACE_DIRECTION_SOURCE + R"(
+uniform samplerCube uSource;
+uniform int uFace;
+uniform float uSize;
+uniform int uSampleCount;
+uniform vec4 uSamples[128];
+
+out vec4 fragmentColor;
+
+void main() {
+    // The view direction is the normal, the samples are rotated into its frame.
+    vec3 n = normalize(faceDirection(uFace, gl_FragCoord.xy / uSize * 2.0 - 1.0));
+    vec3 up = abs(n.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangentX = normalize(cross(up, n));
+    vec3 tangentY = cross(n, tangentX);
+
+    vec3 color = vec3(0.0);
+    float total = 0.0;
+    for (int i = 0; i < uSampleCount; i++) {
+        vec4 s = uSamples[i];
+        vec3 l = tangentX * s.x + tangentY * s.y + n * s.z;
+        color += textureLod(uSource, l, s.w).rgb * s.z;
+        total += s.z;
+    }
+    fragmentColor = vec4(color / total, 1.0);
+}
+)";
+
+// Texels per side of the CPU tasks.
+static const int TILE_SIZE = 16;
+
+static float radicalInverse(uint32_t bits) {
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+// Bilinear sample of a face at (s, t) in [-1, 1], clamped to the face.
+static void sampleBilinear(const Space3d::MipChain::CpuLevel& level, const unsigned int face, const float s,
+                           const float t, float color[3]) {
+    const int width = level.width;
+    const float fx = std::min(std::max((s + 1.0f) * 0.5f * width - 0.5f, 0.0f), static_cast<float>(width - 1));
+    const float fy = std::min(std::max((t + 1.0f) * 0.5f * width - 0.5f, 0.0f), static_cast<float>(width - 1));
+    const int x0 = static_cast<int>(fx);
+    const int y0 = static_cast<int>(fy);
+    const int x1 = std::min(x0 + 1, width - 1);
+    const int y1 = std::min(y0 + 1, width - 1);
+    const float wx = fx - static_cast<float>(x0);
+    const float wy = fy - static_cast<float>(y0);
+
+    const float* texels = level.faces[face].data();
+    for (int c = 0; c < 3; c++) {
+        color[c] = texels[(y0 * width + x0) * 4 + c] * (1.0f - wx) * (1.0f - wy) +
+                   texels[(y0 * width + x1) * 4 + c] * wx * (1.0f - wy) +
+                   texels[(y1 * width + x0) * 4 + c] * (1.0f - wx) * wy + texels[(y1 * width + x1) * 4 + c] * wx * wy;
+    }
+}
+
+// Trilinear sample of the mip chain in the given direction.
+static void sampleCube(const std::vector<Space3d::MipChain::CpuLevel>& levels, const float dir[3], const float lod,
+                       float color[3]) {
+    float s, t;
+    const auto face = Space3d::cubeFace(dir, s, t);
+    const float clamped = std::min(std::max(lod, 0.0f), static_cast<float>(levels.size() - 1));
+    const auto level = static_cast<size_t>(clamped);
+    const float weight = clamped - static_cast<float>(level);
+
+    sampleBilinear(levels[level], face, s, t, color);
+    if (weight > 0.0f && level + 1 < levels.size()) {
+        float next[3];
+        sampleBilinear(levels[level + 1], face, s, t, next);
+        for (int c = 0; c < 3; c++) {
+            color[c] += (next[c] - color[c]) * weight;
+        }
+    }
+}
+
+Space3d::Prefilter::Prefilter(const ProgramCache* cache)
+    : shader(FULLSCREEN_TRIANGLE_VERT, PREFILTER_FRAG, std::nullopt, cache) {
+}
+
+float Space3d::Prefilter::roughness(const int level, const int levels) {
+    return levels > 1 ? static_cast<float>(level) / static_cast<float>(levels - 1) : 0.0f;
+}
+
+std::vector<glm::vec4> Space3d::Prefilter::samples(const int level, const int levels, const int count,
+                                                    const int sourceWidth, const int width) {
+    if (count <= 0 || count > MAX_SAMPLES) {
+        throw std::runtime_error("Prefilter sample count must be between 1 and " + std::to_string(MAX_SAMPLES));
+    }
+
+    // Never sharper than the level being rendered, the source would alias.
+    const int size = std::max(width >> level, 1);
+    const float minLod = std::max(std::log2(static_cast<float>(sourceWidth) / static_cast<float>(size)), 0.0f);
+
+    const float rough = roughness(level, levels);
+    if (rough == 0.0f) {
+        return {glm::vec4{0.0f, 0.0f, 1.0f, minLod}};
+    }
+
+    const float alpha = rough * rough;
+    const float alpha2 = alpha * alpha;
+    const float texelSolidAngle = static_cast<float>(4.0 * M_PI) / (6.0f * sourceWidth * sourceWidth);
+
+    std::vector<glm::vec4> result;
+    for (int i = 0; i < count; i++) {
+        // Hammersley point mapped to the GGX distribution of half vectors.
+        const float u = static_cast<float>(i) / static_cast<float>(count);
+        const float v = radicalInverse(static_cast<uint32_t>(i));
+        const float phi = static_cast<float>(2.0 * M_PI) * u;
+        const float cosTheta = std::sqrt((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+        const float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+        const glm::vec3 h{sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta};
+
+        // Reflected about the half vector with the view along the normal.
+        const glm::vec3 l{2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f};
+        if (l.z <= 0.0f) {
+            continue;
+        }
+
+        // With the view along the normal the pdf of the light direction is D / 4.
+        const float d = alpha2 * cosTheta * cosTheta - cosTheta * cosTheta + 1.0f;
+        const float pdf = alpha2 / (static_cast<float>(M_PI) * d * d) * 0.25f;
+        const float sampleSolidAngle = 1.0f / (static_cast<float>(count) * pdf);
+        const float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+        result.emplace_back(l.x, l.y, l.z, std::max(lod, minLod));
+    }
+    return result;
+}
+
+void Space3d::Prefilter::generate(const GLuint source, const int sourceWidth, const GLuint target, const int width,
+                                  const int levels, const int sampleCount) const {
+    GlState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, source);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glDisable(GL_BLEND);
+
+    fbo.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+
+    shader.use();
+    shader.setInt("uSource", 0);
+    vao.bind();
+
+    for (int level = 0; level < levels; level++) {
+        const auto set = samples(level, levels, sampleCount, sourceWidth, width);
+        shader.setInt("uSampleCount", static_cast<int>(set.size()));
+        shader.setVec4Array("uSamples", set.data(), static_cast<GLsizei>(set.size()));
+
+        const int size = std::max(width >> level, 1);
+        GlState::get().viewport(0, 0, size, size);
+        shader.setFloat("uSize", static_cast<float>(size));
+
+        for (unsigned int i = 0; i < 6; i++) {
+            GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, target, level);
+            shader.setInt("uFace", static_cast<int>(i));
+            shader.drawArrays(GL_TRIANGLES, 3);
+        }
+    }
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_BLEND);
+
+    GlState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, target);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+std::vector<Space3d::MipChain::CpuLevel> Space3d::Prefilter::generateCpu(const std::vector<MipChain::CpuLevel>& source,
+                                                                         const int width, const int levels,
+                                                                         const int sampleCount) {
+    if (source.empty()) {
+        throw std::runtime_error("Prefilter needs at least one source level");
+    }
+
+    struct Tile {
+        int level;
+        unsigned int face;
+        int x;
+        int y;
+    };
+
+    std::vector<MipChain::CpuLevel> result(levels);
+    std::vector<std::vector<glm::vec4>> sets(levels);
+    std::vector<Tile> tiles;
+    for (int level = 0; level < levels; level++) {
+        const int size = std::max(width >> level, 1);
+        result[level].width = size;
+        for (auto& face : result[level].faces) {
+            face.resize(static_cast<size_t>(size) * size * 4);
+        }
+        sets[level] = samples(level, levels, sampleCount, source.front().width, width);
+
+        for (unsigned int face = 0; face < 6; face++) {
+            for (int y = 0; y < size; y += TILE_SIZE) {
+                for (int x = 0; x < size; x += TILE_SIZE) {
+                    tiles.push_back(Tile{level, face, x, y});
+                }
+            }
+        }
+    }
+
+    // The rough levels cost the most per texel but have the fewest texels, so the
+    // tiles of all levels are mixed into the same pool of tasks.
+    parallelFor(tiles.size(), [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto& tile = tiles[i];
+            auto& level = result[tile.level];
+            const auto& set = sets[tile.level];
+            const int size = level.width;
+            float* texels = level.faces[tile.face].data();
+
+            for (int y = tile.y; y < std::min(tile.y + TILE_SIZE, size); y++) {
+                for (int x = tile.x; x < std::min(tile.x + TILE_SIZE, size); x++) {
+                    float n[3];
+                    faceDirection(tile.face, (static_cast<float>(x) + 0.5f) / size * 2.0f - 1.0f,
+                                  (static_cast<float>(y) + 0.5f) / size * 2.0f - 1.0f, n);
+                    const glm::vec3 normal = glm::normalize(glm::vec3{n[0], n[1], n[2]});
+                    const glm::vec3 up =
+                        std::abs(normal.z) < 0.999f ? glm::vec3{0.0f, 0.0f, 1.0f} : glm::vec3{1.0f, 0.0f, 0.0f};
+                    const glm::vec3 tangentX = glm::normalize(glm::cross(up, normal));
+                    const glm::vec3 tangentY = glm::cross(normal, tangentX);
+
+                    float color[3] = {0.0f, 0.0f, 0.0f};
+                    float total = 0.0f;
+                    for (const auto& s : set) {
+                        const glm::vec3 l = tangentX * s.x + tangentY * s.y + normal * s.z;
+                        const float dir[3] = {l.x, l.y, l.z};
+                        float sample[3];
+                        sampleCube(source, dir, s.w, sample);
+                        for (int c = 0; c < 3; c++) {
+                            color[c] += sample[c] * s.z;
+                        }
+                        total += s.z;
+                    }
+
+                    float* texel = &texels[(static_cast<size_t>(y) * size + x) * 4];
+                    for (int c = 0; c < 3; c++) {
+                        texel[c] = color[c] / total;
+                    }
+                    texel[3] = 1.0f;
+                }
+            }
+        }
+    });
+
+    return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "MipChain.hpp"
+#include "Shader.hpp"
+#include "Vao.hpp"
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace Space3d {
+// Convolves a sky cubemap with the GGX distribution for glossy reflections. Level l of
+// the result holds the roughness l / (levels - 1), level 0 being a mirror. The samples
+// are importance sampled and each one reads the level of the sky's mip chain matching
+// the solid angle it stands for, so a few dozen samples per texel are enough.
+class Prefilter {
+public:
+    // Limit of the sample uniform array of the shader.
+    static const int MAX_SAMPLES = 128;
+
+    explicit Prefilter(const ProgramCache* cache = nullptr);
+
+    // Renders all levels of the target cubemap, the source must have its mip chain.
+    void generate(GLuint source, int sourceWidth, GLuint target, int width, int levels, int sampleCount) const;
+
+    // The same on the CPU, the source being the levels returned by MipChain::generateCpu().
+    // Tiles of all faces and levels are spread over the hardware threads.
+    static std::vector<MipChain::CpuLevel> generateCpu(const std::vector<MipChain::CpuLevel>& source, int width,
+                                                       int levels, int sampleCount);
+
+    // Light directions around the normal (0, 0, 1) and the source level to read them at,
+    // weighted by their cosine. Both paths use the same set so that they agree.
+    static std::vector<glm::vec4> samples(int level, int levels, int count, int sourceWidth, int width);
+
+    static float roughness(int level, int levels);
+
+private:
+    Shader shader;
+    // Attribute-less fullscreen triangle.
+    Vao vao;
+    Fbo fbo;
+};
+} // namespace Space3d
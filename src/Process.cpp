@@ -0,0 +1,136 @@
+#include "Process.hpp"
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+#ifdef _WIN32
+// Quotes an argument the way CommandLineToArgvW splits it again.
+static std::string quote(const std::string& arg) {
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+        return arg;
+    }
+    std::string result = "\"";
+    size_t backslashes = 0;
+    for (const auto c : arg) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        // Backslashes are only special in front of a quote.
+        result.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        result += c;
+    }
+    result.append(backslashes * 2, '\\');
+    return result + "\"";
+}
+
+Space3d::Process::Process(const std::vector<std::string>& args) : handle(nullptr) {
+    std::string commandLine;
+    for (const auto& arg : args) {
+        commandLine += (commandLine.empty() ? "" : " ") + quote(arg);
+    }
+
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION info = {};
+    if (!CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &info)) {
+        throw std::runtime_error("Failed to start process: " + commandLine);
+    }
+    CloseHandle(info.hThread);
+    handle = info.hProcess;
+}
+
+Space3d::Process::Process(Process&& other) noexcept : handle(nullptr) {
+    swap(other);
+}
+
+Space3d::Process::~Process() {
+    if (handle) {
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+    }
+}
+
+void Space3d::Process::swap(Process& other) noexcept {
+    std::swap(handle, other.handle);
+}
+
+int Space3d::Process::wait() {
+    if (!handle) {
+        throw std::runtime_error("Process was already waited for");
+    }
+    WaitForSingleObject(handle, INFINITE);
+    DWORD code = 0;
+    GetExitCodeProcess(handle, &code);
+    CloseHandle(handle);
+    handle = nullptr;
+    return static_cast<int>(code);
+}
+#else
+Space3d::Process::Process(const std::vector<std::string>& args) : pid(0) {
+    if (args.empty()) {
+        throw std::runtime_error("Process needs a program to run");
+    }
+
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t child = 0;
+    if (posix_spawnp(&child, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+        throw std::runtime_error("Failed to start process: " + args.front());
+    }
+    pid = child;
+}
+
+Space3d::Process::Process(Process&& other) noexcept : pid(0) {
+    swap(other);
+}
+
+Space3d::Process::~Process() {
+    // Never leaves a zombie behind, even when the owner was unwinding.
+    if (pid) {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void Space3d::Process::swap(Process& other) noexcept {
+    std::swap(pid, other.pid);
+}
+
+int Space3d::Process::wait() {
+    if (!pid) {
+        throw std::runtime_error("Process was already waited for");
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            pid = 0;
+            throw std::runtime_error("Failed to wait for process");
+        }
+    }
+    pid = 0;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
+
+Space3d::Process& Space3d::Process::operator=(Process&& other) noexcept {
+    if (this != &other) {
+        swap(other);
+    }
+    return *this;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Space3d {
+// A child process running a program with the given arguments, the first one being the program.
+// The program is looked up in PATH when it has no directory. Its output goes to the same console.
+class Process {
+public:
+    explicit Process(const std::vector<std::string>& args);
+    Process(const Process& other) = delete;
+    Process(Process&& other) noexcept;
+    ~Process();
+
+    void swap(Process& other) noexcept;
+    Process& operator=(const Process& other) = delete;
+    Process& operator=(Process&& other) noexcept;
+
+    // Blocks until the process exits and returns its exit code, a process killed by a
+    // signal returns -1. Can only be called once.
+    int wait();
+
+private:
+#ifdef _WIN32
+    void* handle;
+#else
+    int pid;
+#endif
+};
+} // namespace Space3d
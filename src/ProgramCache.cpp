@@ -0,0 +1,139 @@
+#include "ProgramCache.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// FNV-1a, good enough to tell apart shader sources and drivers.
+static uint64_t hash(const std::string& str, uint64_t value) {
+    for (const auto c : str) {
+        value ^= static_cast<uint8_t>(c);
+        value *= 0x100000001b3ULL;
+    }
+    return value;
+}
+
+// Suffix of the temporary file of one writer, processes and threads sharing the cache
+// directory never write into the same file.
+static std::string temporarySuffix() {
+#ifdef _WIN32
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    std::stringstream ss;
+    ss << "." << pid << "." << std::hex << std::random_device{}() << ".tmp";
+    return ss.str();
+}
+
+static std::string glString(const GLenum name) {
+    const auto str = glGetString(name);
+    return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+Space3d::ProgramCache::ProgramCache(std::string directory) : directory(std::move(directory)) {
+}
+
+std::string Space3d::ProgramCache::createKey(const std::vector<const std::string*>& sources) const {
+    // A binary is only valid for the exact driver that created it.
+    uint64_t value = 0xcbf29ce484222325ULL;
+    value = hash(glString(GL_VENDOR), value);
+    value = hash(glString(GL_RENDERER), value);
+    value = hash(glString(GL_VERSION), value);
+    for (const auto source : sources) {
+        value = hash(*source, value);
+    }
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+bool Space3d::ProgramCache::load(const GLuint program, const std::string& key) const {
+    if (!isSupported()) {
+        return false;
+    }
+
+    std::ifstream file(path(key), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t format = 0;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    if (!file) {
+        return false;
+    }
+    std::vector<char> binary{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (binary.empty()) {
+        return false;
+    }
+
+    // The driver may reject the binary, for example after an update.
+    glProgramBinary(program, static_cast<GLenum>(format), binary.data(), static_cast<GLsizei>(binary.size()));
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+void Space3d::ProgramCache::store(const GLuint program, const std::string& key) const {
+    if (!isSupported()) {
+        return;
+    }
+
+    int size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(static_cast<size_t>(size));
+    GLenum format = 0;
+    glGetProgramBinary(program, size, nullptr, &format, binary.data());
+
+    // Failing to write the cache only costs the compile time next time.
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    const auto tmp = path(key) + temporarySuffix();
+    bool written;
+    {
+        std::ofstream file(tmp, std::ios::binary);
+        const auto value = static_cast<uint32_t>(format);
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+        written = static_cast<bool>(file);
+    }
+    if (!written) {
+        // The name is never used again, the partial file would stay behind.
+        std::cerr << "Failed to write shader cache file: " << tmp << std::endl;
+        std::filesystem::remove(tmp, ec);
+        return;
+    }
+
+    // Renamed into place so that a concurrent reader never sees a partial file.
+    std::filesystem::rename(tmp, path(key), ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+    }
+}
+
+bool Space3d::ProgramCache::isSupported() {
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) {
+        return false;
+    }
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::string Space3d::ProgramCache::path(const std::string& key) const {
+    return (std::filesystem::path(directory) / (key + ".bin")).string();
+}
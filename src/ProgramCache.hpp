@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace Space3d {
+// On-disk cache of linked shader program binaries. The entries are keyed by the
+// shader sources and by the driver that produced them, a binary that the driver
+// rejects anyway is simply recompiled from the sources.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory);
+
+    std::string createKey(const std::vector<const std::string*>& sources) const;
+    bool load(GLuint program, const std::string& key) const;
+    void store(GLuint program, const std::string& key) const;
+
+    static bool isSupported();
+
+private:
+    std::string path(const std::string& key) const;
+
+    std::string directory;
+};
+} // namespace Space3d
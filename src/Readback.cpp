@@ -0,0 +1,208 @@
+#include "Readback.hpp"
+#include "GlState.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+void Space3d::Readback::transferFormat(const GLenum internalFormat, GLenum& format, GLenum& type) {
+    switch (internalFormat) {
+    case GL_R16F:
+        format = GL_RED;
+        type = GL_HALF_FLOAT;
+        break;
+    case GL_RGB16F:
+        format = GL_RGB;
+        type = GL_HALF_FLOAT;
+        break;
+    case GL_RGBA16F:
+        format = GL_RGBA;
+        type = GL_HALF_FLOAT;
+        break;
+    case GL_RGB32F:
+        format = GL_RGB;
+        type = GL_FLOAT;
+        break;
+    case GL_RGBA32F:
+        format = GL_RGBA;
+        type = GL_FLOAT;
+        break;
+    case GL_RGBA8:
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_RGB8:
+        format = GL_RGB;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_RGBA16UI:
+        format = GL_RGBA_INTEGER;
+        type = GL_UNSIGNED_SHORT;
+        break;
+    default:
+        throw std::runtime_error("Readback of this texture format is not supported");
+    }
+}
+
+Space3d::Readback::Readback(const size_t slots) : slots(std::max<size_t>(slots, 1)), next(1) {
+}
+
+Space3d::Readback::~Readback() {
+    for (auto& slot : slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+    }
+}
+
+size_t Space3d::Readback::bytesPerPixel(const GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_R16F:
+        return 2;
+    case GL_RGB8:
+        return 3;
+    case GL_RGBA8:
+        return 4;
+    case GL_RGB16F:
+        return 6;
+    case GL_RGBA16F:
+    case GL_RGBA16UI:
+        return 8;
+    case GL_RGB32F:
+        return 12;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        throw std::runtime_error("Readback of this texture format is not supported");
+    }
+}
+
+Space3d::Readback::Ticket Space3d::Readback::request(const Skybox::Result& result) {
+    // Any free slot, the requests may be read in any order. The search starts after the
+    // last used slot so that the buffers take turns.
+    Slot* empty = nullptr;
+    for (size_t i = 0; i < slots.size() && !empty; i++) {
+        auto& candidate = slots[(next + i) % slots.size()];
+        if (!candidate.ticket) {
+            empty = &candidate;
+        }
+    }
+    if (!empty) {
+        throw std::runtime_error("Readback ring is full, read a request first");
+    }
+    auto& slot = *empty;
+
+    GLenum format;
+    GLenum type;
+    transferFormat(result.getInternalFormat(), format, type);
+    const size_t bpp = bytesPerPixel(result.getInternalFormat());
+
+    // Lay out all images back to back in a single buffer.
+    const int layers = std::max(result.getLayers(), 1);
+    const unsigned int faces = result.getTarget() == GL_TEXTURE_2D ? 1 : 6;
+    slot.images.clear();
+    slot.offsets.clear();
+    size_t offset = 0;
+    for (int layer = 0; layer < layers; layer++) {
+        for (unsigned int face = 0; face < faces; face++) {
+            for (int level = 0; level < result.getLevels(); level++) {
+                const int size = std::max(result.getWidth() >> level, 1);
+                const size_t bytes = static_cast<size_t>(size) * size * bpp;
+                slot.images.push_back(Image{layer, face, level, size, nullptr, bytes});
+                slot.offsets.push_back(offset);
+                offset += bytes;
+            }
+        }
+    }
+
+    if (slot.pbo.getSize() < offset) {
+        slot.pbo.allocate(offset);
+    }
+
+    fbo.bind();
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    slot.pbo.bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    for (size_t i = 0; i < slot.images.size(); i++) {
+        const auto& image = slot.images[i];
+        Skybox::attach(Skybox::Target{result.getTarget(), result.get(), image.layer, image.level, image.width},
+                       image.face);
+        glReadPixels(0, 0, image.width, image.width, format, type, reinterpret_cast<void*>(slot.offsets[i]));
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.ticket = next++;
+    return slot.ticket;
+}
+
+bool Space3d::Readback::isReady(const Ticket ticket) const {
+    const auto& slot = find(ticket);
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(slot.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+    return status == GL_SIGNALED;
+}
+
+void Space3d::Readback::read(const Ticket ticket, const std::function<void(const std::vector<Image>&)>& callback) {
+    auto& slot = find(ticket);
+
+    // Wait in small steps, the first one also flushes the queued commands.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        const auto status = glClientWaitSync(slot.fence, flags, 1000000);
+        if (status == GL_WAIT_FAILED) {
+            throw std::runtime_error("Failed to wait for the readback fence");
+        }
+        if (status != GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        flags = 0;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    slot.ticket = 0;
+
+    slot.pbo.bind();
+    const auto* base = static_cast<const uint8_t*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(slot.pbo.getSize()), GL_MAP_READ_BIT));
+    if (!base) {
+        GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        throw std::runtime_error("Failed to map the readback buffer");
+    }
+
+    auto images = slot.images;
+    for (size_t i = 0; i < images.size(); i++) {
+        images[i].data = base + slot.offsets[i];
+    }
+
+    try {
+        callback(images);
+    } catch (...) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        std::rethrow_exception(std::current_exception());
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    GlState::get().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Space3d::Readback::Slot& Space3d::Readback::find(const Ticket ticket) {
+    for (auto& slot : slots) {
+        if (slot.ticket && slot.ticket == ticket) {
+            return slot;
+        }
+    }
+    throw std::runtime_error("Readback request is not pending");
+}
+
+const Space3d::Readback::Slot& Space3d::Readback::find(const Ticket ticket) const {
+    for (const auto& slot : slots) {
+        if (slot.ticket && slot.ticket == ticket) {
+            return slot;
+        }
+    }
+    throw std::runtime_error("Readback request is not pending");
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Pbo.hpp"
+#include "Skybox.hpp"
+#include <functional>
+#include <vector>
+
+namespace Space3d {
+// Downloads cubemaps to the CPU without stalling the pipeline. A request copies
+// every face and mip level into a pixel buffer object and fences it, the data
+// is only mapped once the GPU is done with it. The buffers form a ring, so the
+// readback of one skybox can overlap the generation of the next one.
+class Readback {
+public:
+    using Ticket = uint64_t;
+
+    // A view into the mapped buffer, valid only inside the read callback.
+    struct Image {
+        int layer;
+        unsigned int face;
+        int level;
+        int width;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    explicit Readback(size_t slots = 2);
+    Readback(const Readback& other) = delete;
+    ~Readback();
+
+    Readback& operator=(const Readback& other) = delete;
+
+    // Queues the copy of all faces, layers and mip levels of the result. A 2D
+    // texture is read as a single face.
+    // Throws if all slots hold requests that were not read yet, the requests can be
+    // read in any order.
+    Ticket request(const Skybox::Result& result);
+    // Returns true if the request can be read without blocking.
+    bool isReady(Ticket ticket) const;
+    // Waits for the request and passes the images to the callback, the slot is
+    // free for a new request afterwards.
+    void read(Ticket ticket, const std::function<void(const std::vector<Image>&)>& callback);
+
+    static size_t bytesPerPixel(GLenum internalFormat);
+    // Pixel format and type the images of a texture with the internal format are read as.
+    static void transferFormat(GLenum internalFormat, GLenum& format, GLenum& type);
+
+private:
+    struct Slot {
+        Pbo pbo;
+        GLsync fence = nullptr;
+        Ticket ticket = 0;
+        std::vector<Image> images;
+        // Offsets of the images in the buffer.
+        std::vector<size_t> offsets;
+    };
+
+    Slot& find(Ticket ticket);
+    const Slot& find(Ticket ticket) const;
+
+    std::vector<Slot> slots;
+    Fbo fbo;
+    Ticket next;
+};
+} // namespace Space3d
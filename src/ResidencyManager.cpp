@@ -0,0 +1,319 @@
+#include "ResidencyManager.hpp"
+#include "BlockCompression.hpp"
+#include "Readback.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static unsigned int faceCount(const GLenum target) {
+    return target == GL_TEXTURE_2D ? 1 : 6;
+}
+
+// Bytes of one face of the given width, BC1 blocks or tightly packed texels.
+static size_t imageBytes(const GLenum internalFormat, const int width) {
+    if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+        return Space3d::bc1Size(width, width);
+    }
+    return static_cast<size_t>(width) * width * Space3d::Readback::bytesPerPixel(internalFormat);
+}
+
+Space3d::ResidencyManager::ResidencyManager(const size_t budget, const Backing backing, const int minWidth,
+                                            std::string directory)
+    : budget(budget), backing(backing), minWidth(minWidth), directory(std::move(directory)), next(1),
+      residentBytes(0) {
+}
+
+Space3d::ResidencyManager::~ResidencyManager() {
+    for (auto& pair : entries) {
+        if (pair.second.copy) {
+            releaseCopy(*pair.second.copy);
+        }
+        if (pair.second.specularCopy) {
+            releaseCopy(*pair.second.specularCopy);
+        }
+    }
+}
+
+size_t Space3d::ResidencyManager::byteCost(const Skybox::Result& result) {
+    size_t bytes = 0;
+    const size_t faces = faceCount(result.getTarget()) * std::max(result.getLayers(), 1);
+    for (int level = 0; level < result.getLevels(); level++) {
+        bytes += faces * imageBytes(result.getInternalFormat(), std::max(result.getWidth() >> level, 1));
+    }
+    if (const auto* specular = result.getSpecular()) {
+        bytes += byteCost(*specular);
+    }
+    return bytes;
+}
+
+Space3d::ResidencyManager::Handle Space3d::ResidencyManager::add(Skybox::Result&& result) {
+    if (result.getTarget() != GL_TEXTURE_CUBE_MAP && result.getTarget() != GL_TEXTURE_2D) {
+        throw std::runtime_error("Only cubemaps and 2D textures can be managed");
+    }
+
+    const Handle handle = next++;
+    lru.push_front(handle);
+    auto& entry =
+        entries.emplace(handle, Entry{std::move(result), std::nullopt, std::nullopt, true, lru.begin()}).first->second;
+    residentBytes += byteCost(entry.result);
+    enforceBudget(handle);
+    return handle;
+}
+
+const Space3d::Skybox::Result& Space3d::ResidencyManager::bind(const Handle handle, const GLuint unit) {
+    auto& entry = find(handle);
+    if (entry.copy || entry.specularCopy) {
+        restore(entry);
+    }
+    lru.splice(lru.begin(), lru, entry.lru);
+    enforceBudget(handle);
+
+    entry.result.bind(unit);
+    return entry.result;
+}
+
+Space3d::Skybox::Result Space3d::ResidencyManager::remove(const Handle handle) {
+    auto& entry = find(handle);
+    if (entry.copy || entry.specularCopy) {
+        restore(entry);
+    }
+    residentBytes -= byteCost(entry.result);
+
+    Skybox::Result result = std::move(entry.result);
+    lru.erase(entry.lru);
+    entries.erase(handle);
+    return result;
+}
+
+void Space3d::ResidencyManager::setBudget(const size_t budget) {
+    this->budget = budget;
+    enforceBudget(lru.empty() ? 0 : lru.front());
+}
+
+Space3d::ResidencyManager::Entry& Space3d::ResidencyManager::find(const Handle handle) {
+    const auto it = entries.find(handle);
+    if (it == entries.end()) {
+        throw std::runtime_error("Sky is not managed by this residency manager");
+    }
+    return it->second;
+}
+
+void Space3d::ResidencyManager::restore(Entry& entry) {
+    const size_t before = byteCost(entry.result);
+
+    if (entry.copy) {
+        Skybox::Result full = upload(*entry.copy, 0);
+        full.setIrradiance(entry.result.getIrradiance());
+        full.setLights(entry.result.getLights());
+        // Still resident when the sky was only downgraded.
+        full.setSpecular(entry.result.takeSpecular());
+
+        Skybox::Result old = std::move(entry.result);
+        entry.result = std::move(full);
+        releaseCopy(*entry.copy);
+        entry.copy.reset();
+    }
+    if (entry.specularCopy) {
+        entry.result.setSpecular(std::make_unique<Skybox::Result>(upload(*entry.specularCopy, 0)));
+        releaseCopy(*entry.specularCopy);
+        entry.specularCopy.reset();
+    }
+
+    const size_t after = byteCost(entry.result);
+    residentBytes = residentBytes - before + after;
+    stats.restores++;
+    stats.restoredBytes += after - before;
+    entry.resident = true;
+}
+
+void Space3d::ResidencyManager::downgrade(const Handle handle, Entry& entry, const int levels) {
+    const size_t before = byteCost(entry.result);
+    if (!entry.copy) {
+        entry.copy = download(handle, entry.result, false);
+    }
+
+    // The copy has all levels, the ones dropped earlier are skipped as well.
+    const int firstLevel = entry.copy->levels - entry.result.getLevels() + levels;
+    Skybox::Result smaller = upload(*entry.copy, firstLevel);
+    smaller.setIrradiance(entry.result.getIrradiance());
+    smaller.setLights(entry.result.getLights());
+    smaller.setSpecular(entry.result.takeSpecular());
+
+    Skybox::Result old = std::move(entry.result);
+    entry.result = std::move(smaller);
+
+    const size_t after = byteCost(entry.result);
+    residentBytes = residentBytes - before + after;
+    stats.downgrades++;
+    stats.evictedBytes += before - after;
+}
+
+void Space3d::ResidencyManager::evict(const Handle handle, Entry& entry) {
+    if (!entry.copy) {
+        entry.copy = download(handle, entry.result, false);
+    }
+    if (const auto* specular = entry.result.getSpecular()) {
+        entry.specularCopy = download(handle, *specular, true);
+    }
+
+    // Only the irradiance and the lights are kept, both textures are freed with the old result.
+    const size_t freed = byteCost(entry.result);
+    Skybox::Result stub;
+    stub.setIrradiance(entry.result.getIrradiance());
+    stub.setLights(entry.result.getLights());
+    Skybox::Result old = std::move(entry.result);
+    entry.result = std::move(stub);
+
+    residentBytes -= freed;
+    stats.evictions++;
+    stats.evictedBytes += freed;
+    entry.resident = false;
+}
+
+void Space3d::ResidencyManager::enforceBudget(const Handle keep) {
+    // First the least recently used skies lose their finest levels, as few as needed.
+    if (minWidth > 0) {
+        for (auto it = lru.rbegin(); it != lru.rend() && residentBytes > budget; ++it) {
+            auto& entry = entries.at(*it);
+            if (*it == keep || !entry.resident) {
+                continue;
+            }
+
+            const auto& result = entry.result;
+            const size_t faces = faceCount(result.getTarget());
+            int levels = 0;
+            size_t saved = 0;
+            while (residentBytes - saved > budget && levels + 1 < result.getLevels() &&
+                   (result.getWidth() >> (levels + 1)) >= minWidth) {
+                saved += faces * imageBytes(result.getInternalFormat(), result.getWidth() >> levels);
+                levels++;
+            }
+            if (levels > 0) {
+                downgrade(*it, entry, levels);
+            }
+        }
+    }
+
+    // Then they are evicted, the sky that is about to be used never is.
+    for (auto it = lru.rbegin(); it != lru.rend() && residentBytes > budget; ++it) {
+        auto& entry = entries.at(*it);
+        if (*it != keep && entry.resident) {
+            evict(*it, entry);
+        }
+    }
+}
+
+Space3d::ResidencyManager::Copy Space3d::ResidencyManager::download(const Handle handle,
+                                                                   const Skybox::Result& result,
+                                                                   const bool specular) {
+    Copy copy{result.getTarget(), result.getWidth(), result.getLevels(), result.getInternalFormat(), {}, {}, 0};
+    const unsigned int faces = faceCount(copy.target);
+    copy.images.resize(faces * copy.levels);
+
+    if (copy.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+        // Readback has no compressed formats, the blocks are copied as they are.
+        result.bind();
+        for (unsigned int face = 0; face < faces; face++) {
+            const GLenum image = copy.target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+            for (int level = 0; level < copy.levels; level++) {
+                auto& data = copy.images[face * copy.levels + level];
+                data.resize(imageBytes(copy.internalFormat, std::max(copy.width >> level, 1)));
+                glGetCompressedTexImage(image, level, data.data());
+            }
+        }
+    } else {
+        Readback readback(1);
+        readback.read(readback.request(result), [&](const std::vector<Readback::Image>& images) {
+            for (const auto& image : images) {
+                copy.images[image.face * copy.levels + image.level].assign(image.data, image.data + image.size);
+            }
+        });
+    }
+
+    if (backing == Backing::CompressedMemory && copy.internalFormat == GL_RGB8 &&
+        GLAD_GL_EXT_texture_compression_s3tc) {
+        for (int level = 0; level < copy.levels; level++) {
+            const int width = std::max(copy.width >> level, 1);
+            for (unsigned int face = 0; face < faces; face++) {
+                auto& data = copy.images[face * copy.levels + level];
+                data = compressBc1(data.data(), width, width);
+            }
+        }
+        copy.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    for (const auto& data : copy.images) {
+        copy.bytes += data.size();
+    }
+
+    if (backing == Backing::Disk) {
+        std::filesystem::create_directories(directory);
+        copy.path = (std::filesystem::path(directory) /
+                     (std::to_string(handle) + (specular ? "-specular.bin" : ".bin")))
+                        .string();
+        std::ofstream file(copy.path, std::ios::binary);
+        for (const auto& data : copy.images) {
+            file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        }
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + copy.path);
+        }
+        copy.images.clear();
+        copy.images.shrink_to_fit();
+    }
+
+    stats.backingBytes += copy.bytes;
+    return copy;
+}
+
+Space3d::Skybox::Result Space3d::ResidencyManager::upload(const Copy& copy, const int firstLevel) {
+    const unsigned int faces = faceCount(copy.target);
+
+    std::vector<std::vector<uint8_t>> loaded;
+    if (!copy.path.empty()) {
+        std::ifstream file(copy.path, std::ios::binary);
+        loaded.resize(faces * copy.levels);
+        for (unsigned int face = 0; face < faces; face++) {
+            for (int level = 0; level < copy.levels; level++) {
+                auto& data = loaded[face * copy.levels + level];
+                data.resize(imageBytes(copy.internalFormat, std::max(copy.width >> level, 1)));
+                file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            }
+        }
+        if (!file) {
+            throw std::runtime_error("Failed to read file: " + copy.path);
+        }
+    }
+    const auto& images = copy.path.empty() ? copy.images : loaded;
+
+    Skybox::Result result;
+    const int width = std::max(copy.width >> firstLevel, 1);
+    const int levels = copy.levels - firstLevel;
+    if (copy.target == GL_TEXTURE_2D) {
+        result.setTextureStorage(width, levels, copy.internalFormat);
+    } else {
+        result.setStorage(width, levels, copy.internalFormat);
+    }
+
+    for (unsigned int face = 0; face < faces; face++) {
+        for (int level = firstLevel; level < copy.levels; level++) {
+            const auto& data = images[face * copy.levels + level];
+            result.setImage(face, level - firstLevel, data.data(), data.size());
+        }
+    }
+
+    if (levels > 1) {
+        result.bind();
+        glTexParameteri(copy.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    return result;
+}
+
+void Space3d::ResidencyManager::releaseCopy(Copy& copy) {
+    if (!copy.path.empty()) {
+        std::error_code error;
+        std::filesystem::remove(copy.path, error);
+    }
+    stats.backingBytes -= copy.bytes;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Skybox.hpp"
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Space3d {
+// Keeps several skies within a GPU memory budget. Every sky is charged its full size with all
+// mip levels and its specular cubemap. When the resident skies exceed the budget, the least
+// recently bound ones first lose their finest levels down to the minimum width, then they are
+// evicted. A sky that was downgraded or evicted is restored by the next bind().
+//
+// Evicted and downgraded skies keep a copy of their texels outside of the GPU, the backing.
+// Irradiance and lights stay with the sky, they take no GPU memory.
+class ResidencyManager {
+public:
+    using Handle = uint64_t;
+
+    enum class Backing {
+        // Exact copy in CPU memory.
+        Memory,
+        // RGB8 skies are BC1 encoded into CPU memory, a sixth of the size. They are restored as BC1
+        // cubemaps and stay compressed on the GPU. Other formats are kept exact.
+        CompressedMemory,
+        // Exact copy in a file per sky in the directory.
+        Disk,
+    };
+
+    struct Stats {
+        size_t evictions = 0;
+        size_t downgrades = 0;
+        size_t restores = 0;
+        // GPU memory freed by evictions and downgrades, and uploaded again by restores.
+        size_t evictedBytes = 0;
+        size_t restoredBytes = 0;
+        // Current size of the backing copies.
+        size_t backingBytes = 0;
+    };
+
+    // A zero minimum width disables the downgrades, the skies are evicted right away.
+    explicit ResidencyManager(size_t budget, Backing backing = Backing::Memory, int minWidth = 256,
+                              std::string directory = "residency");
+    ResidencyManager(const ResidencyManager& other) = delete;
+    ~ResidencyManager();
+
+    ResidencyManager& operator=(const ResidencyManager& other) = delete;
+
+    // Takes over the sky as the most recently used one. Other skies may be downgraded or evicted
+    // to make room, a sky larger than the whole budget is still accepted. Only single cubemaps
+    // and 2D textures are supported.
+    Handle add(Skybox::Result&& result);
+    // Restores the sky in full if needed, binds it and marks it as the most recently used one.
+    const Skybox::Result& bind(Handle handle, GLuint unit = 0);
+    // Returns the sky restored in full, it is no longer tracked.
+    Skybox::Result remove(Handle handle);
+
+    void setBudget(size_t budget);
+    size_t getBudget() const {
+        return budget;
+    }
+    // GPU memory of the resident skies.
+    size_t getResidentBytes() const {
+        return residentBytes;
+    }
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    // GPU memory of the texture with all of its levels and of its specular cubemap.
+    static size_t byteCost(const Skybox::Result& result);
+
+private:
+    // Texels of every face and level, indexed by face * levels + level.
+    struct Copy {
+        GLenum target;
+        int width;
+        int levels;
+        GLenum internalFormat;
+        std::vector<std::vector<uint8_t>> images;
+        // Set when the images live in this file instead.
+        std::string path;
+        size_t bytes;
+    };
+
+    struct Entry {
+        Skybox::Result result;
+        // Full resolution copy of a downgraded or evicted sky.
+        std::optional<Copy> copy;
+        std::optional<Copy> specularCopy;
+        // The sky and its specular cubemap are resident, though possibly downgraded.
+        bool resident;
+        std::list<Handle>::iterator lru;
+    };
+
+    Entry& find(Handle handle);
+    void restore(Entry& entry);
+    void downgrade(Handle handle, Entry& entry, int levels);
+    void evict(Handle handle, Entry& entry);
+    // Downgrades and then evicts the least recently used skies until the budget is met.
+    void enforceBudget(Handle keep);
+
+    Copy download(Handle handle, const Skybox::Result& result, bool specular);
+    Skybox::Result upload(const Copy& copy, int firstLevel);
+    void releaseCopy(Copy& copy);
+
+    size_t budget;
+    Backing backing;
+    int minWidth;
+    std::string directory;
+    Handle next;
+    size_t residentBytes;
+    Stats stats;
+    std::unordered_map<Handle, Entry> entries;
+    // Most recently used first.
+    std::list<Handle> lru;
+};
+} // namespace Space3d
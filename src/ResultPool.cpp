@@ -0,0 +1,49 @@
+#include "ResultPool.hpp"
+
+Space3d::ResultPool::ResultPool(const size_t maxPerKey) : maxPerKey(maxPerKey), hits(0), misses(0) {
+}
+
+Space3d::Skybox::Result Space3d::ResultPool::acquire(const int width, const int levels, const GLenum internalFormat) {
+    auto it = free.find(Key{width, levels, internalFormat});
+    if (it != free.end() && !it->second.empty()) {
+        hits++;
+        auto result = std::move(it->second.back());
+        it->second.pop_back();
+        return result;
+    }
+
+    misses++;
+    Skybox::Result result;
+    result.setStorage(width, levels, internalFormat);
+    return result;
+}
+
+void Space3d::ResultPool::recycle(Skybox::Result&& result) {
+    // The specular cubemap has its own size and format, it is pooled separately.
+    if (auto specular = result.takeSpecular()) {
+        recycle(std::move(*specular));
+    }
+
+    // Cubemap arrays are sized by their caller, they are not pooled.
+    if (!result.get() || !result.getWidth() || result.getTarget() != GL_TEXTURE_CUBE_MAP) {
+        return;
+    }
+
+    // Only the storage is reused, the next sky must not inherit the data computed from this one.
+    ShCoefficients none;
+    none.fill(glm::vec3{0.0f});
+    result.setIrradiance(none);
+    result.setLights({});
+
+    // Anything above the limit is freed, the pool should not hoard GPU memory.
+    auto& results = free[Key{result.getWidth(), result.getLevels(), result.getInternalFormat()}];
+    if (results.size() < maxPerKey) {
+        results.push_back(std::move(result));
+    } else {
+        Skybox::Result discard = std::move(result);
+    }
+}
+
+void Space3d::ResultPool::clear() {
+    free.clear();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Skybox.hpp"
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace Space3d {
+// Keeps released cubemaps around so that generating a new skybox of the same
+// size and format reuses their storage instead of allocating new textures.
+class ResultPool {
+public:
+    explicit ResultPool(size_t maxPerKey = 2);
+
+    // Returns a cubemap with the storage already allocated, a recycled one if possible.
+    Skybox::Result acquire(int width, int levels, GLenum internalFormat);
+    void recycle(Skybox::Result&& result);
+    void clear();
+
+    size_t getHits() const {
+        return hits;
+    }
+    size_t getMisses() const {
+        return misses;
+    }
+
+private:
+    using Key = std::tuple<int, int, GLenum>;
+
+    size_t maxPerKey;
+    size_t hits;
+    size_t misses;
+    std::map<Key, std::vector<Skybox::Result>> free;
+};
+} // namespace Space3d
@@ -0,0 +1,106 @@
+#include "SeedSearch.hpp"
+#include "CubeMath.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/ext/scalar_constants.hpp>
+#include <glm/geometric.hpp>
+
+// Seeds evaluated per thread before the matches are collected, keeps the stats of a large
+// search from piling up.
+static constexpr int64_t SEEDS_PER_THREAD = 256;
+
+Space3d::SeedSearch::SeedSearch(const SkyboxParams& params, const int width, const float octaves,
+                                const float coverageThreshold)
+    : params(params), octaves(octaves), coverageThreshold(coverageThreshold) {
+    // The centers of the texels of a cubemap of the given width and their solid angles.
+    const int n = std::max(width, 1);
+    const float texel = 2.0f / static_cast<float>(n);
+    samples.reserve(6 * static_cast<size_t>(n) * n);
+    for (unsigned int face = 0; face < 6; face++) {
+        for (int y = 0; y < n; y++) {
+            const float t0 = -1.0f + static_cast<float>(y) * texel;
+            const float t1 = t0 + texel;
+            for (int x = 0; x < n; x++) {
+                const float s0 = -1.0f + static_cast<float>(x) * texel;
+                const float s1 = s0 + texel;
+                const float solidAngle = faceAreaElement(s0, t0) - faceAreaElement(s0, t1) -
+                                         faceAreaElement(s1, t0) + faceAreaElement(s1, t1);
+
+                float dir[3];
+                faceDirection(face, (s0 + s1) * 0.5f, (t0 + t1) * 0.5f, dir);
+                samples.push_back(Sample{glm::normalize(glm::vec3{dir[0], dir[1], dir[2]}), solidAngle});
+            }
+        }
+    }
+}
+
+Space3d::SeedSearch::Stats Space3d::SeedSearch::evaluate(const int64_t seed) const {
+    const auto layout = Skybox::createLayout(seed, params);
+
+    // The nebula layers are added on top of each other, each direction saturates like a texel.
+    glm::vec3 nebulas(0.0f);
+    float covered = 0.0f;
+    for (const auto& sample : samples) {
+        glm::vec3 color(0.0f);
+        float alpha = 0.0f;
+        for (const auto& nebula : layout.nebulas) {
+            const float c = Skybox::nebulaAlpha(nebula, sample.direction, octaves, params.nebulaTime);
+            color += glm::vec3(nebula.color) * c;
+            alpha += c;
+        }
+        nebulas += glm::min(color, glm::vec3(1.0f)) * sample.solidAngle;
+        if (alpha >= coverageThreshold) {
+            covered += sample.solidAngle;
+        }
+    }
+
+    // Stars are far smaller than a sample, their total light is spread over the sphere.
+    glm::vec3 stars(0.0f);
+    for (const auto& batch : layout.stars) {
+        for (const auto& star : batch.vertices) {
+            stars += Skybox::starIntensity(batch, star);
+        }
+    }
+
+    const float sphere = 4.0f * glm::pi<float>();
+    Stats stats;
+    stats.seed = seed;
+    stats.layers = static_cast<int>(layout.nebulas.size());
+    stats.meanColor = glm::min((nebulas + stars) / sphere, glm::vec3(1.0f));
+    stats.brightness = 0.2126f * stats.meanColor.x + 0.7152f * stats.meanColor.y + 0.0722f * stats.meanColor.z;
+    stats.coverage = covered / sphere;
+    return stats;
+}
+
+std::vector<Space3d::SeedSearch::Stats> Space3d::SeedSearch::search(const int64_t first, const int64_t count,
+                                                                     const Predicate& predicate) const {
+    std::vector<Stats> matches;
+    const int64_t block = SEEDS_PER_THREAD * static_cast<int64_t>(hardwareThreads());
+    std::vector<Stats> stats;
+
+    for (int64_t begin = 0; begin < count; begin += block) {
+        stats.resize(static_cast<size_t>(std::min(block, count - begin)));
+        parallelFor(stats.size(), [&](const size_t from, const size_t to) {
+            for (size_t i = from; i < to; i++) {
+                stats[i] = evaluate(first + begin + static_cast<int64_t>(i));
+            }
+        });
+
+        // The predicate runs on the calling thread only.
+        for (const auto& s : stats) {
+            if (predicate(s)) {
+                matches.push_back(s);
+            }
+        }
+    }
+    return matches;
+}
+
+float Space3d::SeedSearch::colorDistance(const glm::vec3& a, const glm::vec3& b) {
+    const auto chromaticity = [](const glm::vec3& color) {
+        const float sum = color.x + color.y + color.z;
+        return sum > 0.0f ? color / sum : glm::vec3(1.0f / 3.0f);
+    };
+    return glm::length(chromaticity(a) - chromaticity(b));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Skybox.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Space3d {
+// Rates seeds on the CPU without rendering them, so that only the interesting ones are generated
+// at full size. The nebula layers of a seed are evaluated with the noise port at a few directions
+// per face and a few octaves, the stars are summed from the layout. The stats depend on the
+// parameters the search was created with, pass the ones the winners will be rendered with.
+class SeedSearch {
+public:
+    struct Stats {
+        int64_t seed;
+        int layers;
+        // Mean color over the sphere, stars included. Every direction is clamped to 1 like a texel
+        // of the RGB8 cubemap.
+        glm::vec3 meanColor;
+        // Luminance of the mean color.
+        float brightness;
+        // Fraction of the sphere where the alphas of the nebula layers add up to the threshold.
+        float coverage;
+    };
+
+    using Predicate = std::function<bool(const Stats& stats)>;
+
+    // The width is the number of directions per face edge. Fewer octaves than the renderer uses
+    // are plenty, the finer ones barely change the stats of a whole layer.
+    explicit SeedSearch(const SkyboxParams& params = SkyboxParams{}, int width = 16, float octaves = 2.0f,
+                        float coverageThreshold = 0.1f);
+
+    Stats evaluate(int64_t seed) const;
+    // Evaluates the seeds from first to first + count - 1 on all CPU cores, one seed per thread at
+    // a time, and returns the stats of those matching the predicate in seed order.
+    std::vector<Stats> search(int64_t first, int64_t count, const Predicate& predicate) const;
+
+    // Distance between the chromaticities of two colors, from 0 to about 1.4, their brightness is ignored.
+    static float colorDistance(const glm::vec3& a, const glm::vec3& b);
+
+private:
+    struct Sample {
+        glm::vec3 direction;
+        float solidAngle;
+    };
+
+    SkyboxParams params;
+    float octaves;
+    float coverageThreshold;
+    std::vector<Sample> samples;
+};
+} // namespace Space3d
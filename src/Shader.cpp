@@ -1,11 +1,29 @@
 #include "Shader.hpp"
+#include "GlState.hpp"
 #include <stdexcept>
 
 Space3d::Shader::Shader(const std::string& vertSource, const std::string& fragSource,
-                        const std::optional<std::string>& geomSource)
+                        const std::optional<std::string>& geomSource, const ProgramCache* cache)
     : vertex(0), fragment(0), geometry(0), program(0) {
 
     try {
+        // Skip the compilation entirely if the driver accepts a cached binary.
+        std::string key;
+        if (cache) {
+            std::vector<const std::string*> sources = {&vertSource, &fragSource};
+            if (geomSource.has_value()) {
+                sources.push_back(&geomSource.value());
+            }
+            key = cache->createKey(sources);
+
+            program = glCreateProgram();
+            if (cache->load(program, key)) {
+                return;
+            }
+            GlState::get().deleteProgram(program);
+            program = 0;
+        }
+
         auto vertexSrc = vertSource.c_str();
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vertexSrc, nullptr);
@@ -32,9 +50,16 @@ Space3d::Shader::Shader(const std::string& vertSource, const std::string& fragSo
         if (geomSource.has_value()) {
             glAttachShader(program, geometry);
         }
+        if (cache && ProgramCache::isSupported()) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
         glLinkProgram(program);
         checkProgramStatus();
 
+        if (cache) {
+            cache->store(program, key);
+        }
+
     } catch (...) {
         destroy();
         std::rethrow_exception(std::current_exception());
@@ -67,7 +92,7 @@ void Space3d::Shader::checkProgramStatus() const {
 
 void Space3d::Shader::destroy() {
     if (program) {
-        glDeleteProgram(program);
+        GlState::get().deleteProgram(program);
         program = 0;
     }
     if (vertex) {
@@ -85,7 +110,7 @@ void Space3d::Shader::destroy() {
 }
 
 void Space3d::Shader::use() const {
-    glUseProgram(program);
+    GlState::get().useProgram(program);
 }
 
 void Space3d::Shader::setInt(const std::string& location, const int value) const {
@@ -96,6 +121,10 @@ void Space3d::Shader::setFloat(const std::string& location, const float value) c
     glUniform1f(glGetUniformLocation(program, location.c_str()), value);
 }
 
+void Space3d::Shader::setFloatArray(const std::string& location, const float* values, const GLsizei count) const {
+    glUniform1fv(glGetUniformLocation(program, location.c_str()), count, values);
+}
+
 void Space3d::Shader::setVec2(const std::string& location, const glm::vec2& value) const {
     glUniform2f(glGetUniformLocation(program, location.c_str()), value.x, value.y);
 }
@@ -108,6 +137,10 @@ void Space3d::Shader::setVec4(const std::string& location, const glm::vec4& valu
     glUniform4f(glGetUniformLocation(program, location.c_str()), value.x, value.y, value.z, value.w);
 }
 
+void Space3d::Shader::setVec4Array(const std::string& location, const glm::vec4* values, const GLsizei count) const {
+    glUniform4fv(glGetUniformLocation(program, location.c_str()), count, &values[0].x);
+}
+
 void Space3d::Shader::setMat4(const std::string& location, const glm::mat4x4& value) const {
     glUniformMatrix4fv(glGetUniformLocation(program, location.c_str()), 1, GL_FALSE, &value[0][0]);
 }
@@ -115,3 +148,7 @@ void Space3d::Shader::setMat4(const std::string& location, const glm::mat4x4& va
 void Space3d::Shader::drawArrays(const GLenum mode, const GLsizei count) const {
     glDrawArrays(mode, 0, count);
 }
+
+void Space3d::Shader::drawArrays(const GLenum mode, const GLint first, const GLsizei count) const {
+    glDrawArrays(mode, first, count);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ProgramCache.hpp"
 #include <glad/glad.h>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
@@ -11,7 +12,8 @@
 namespace Space3d {
 class Shader {
 public:
-    Shader(const std::string& vertSource, const std::string& fragSource, const std::optional<std::string>& geomSource);
+    Shader(const std::string& vertSource, const std::string& fragSource, const std::optional<std::string>& geomSource,
+           const ProgramCache* cache = nullptr);
     ~Shader();
 
     void checkShaderStatus(GLuint shader) const;
@@ -20,11 +22,14 @@ public:
     void use() const;
     void setInt(const std::string& location, int value) const;
     void setFloat(const std::string& location, float value) const;
+    void setFloatArray(const std::string& location, const float* values, GLsizei count) const;
     void setVec2(const std::string& location, const glm::vec2& value) const;
     void setVec3(const std::string& location, const glm::vec3& value) const;
     void setVec4(const std::string& location, const glm::vec4& value) const;
+    void setVec4Array(const std::string& location, const glm::vec4* values, GLsizei count) const;
     void setMat4(const std::string& location, const glm::mat4x4& value) const;
     void drawArrays(const GLenum mode, const GLsizei count) const;
+    void drawArrays(const GLenum mode, const GLint first, const GLsizei count) const;
 
     GLuint get() const {
         return program;
@@ -0,0 +1,152 @@
+#include "SkyEditor.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+
+// Applies the intensity and falloff of a layer to its density like the nebula shader does,
+// the result is blended on top with the layer color.
+static const std::string EDITOR_FRAG = std::string("#version 330 core\n") + Space3d::FACE_DIRECTION_SOURCE + R"(
+uniform samplerCube uDensity;
+uniform vec4 uColor;
+uniform float uIntensity;
+uniform float uFalloff;
+uniform int uFace;
+uniform float uSize;
+
+out vec4 fragmentColor;
+
+void main() {
+    vec3 dir = faceDirection(uFace, gl_FragCoord.xy / uSize * 2.0 - 1.0);
+    float n = textureLod(uDensity, dir, 0.0).r;
+    float c = pow(min(1.0, n * uIntensity), uFalloff);
+    fragmentColor = vec4(uColor.xyz, c);
+}
+)";
+
+Space3d::SkyEditor::SkyEditor(const Skybox& skybox, const int64_t seed, const int width,
+                              const SkyboxParams& params, const ProgramCache* cache)
+    : SkyEditor(skybox, Skybox::createLayout(seed, params), width, params, cache) {
+}
+
+Space3d::SkyEditor::SkyEditor(const Skybox& skybox, const Skybox::Layout& layout, const int width,
+                              const SkyboxParams& params, const ProgramCache* cache)
+    : skybox(skybox), params(params), width(width), starsDirty(true), compositeDirty(true),
+      shader(FULLSCREEN_TRIANGLE_VERT, EDITOR_FRAG, std::nullopt, cache) {
+
+    this->layout.stars = layout.stars;
+    for (const auto& nebula : layout.nebulas) {
+        addNebula(nebula);
+    }
+
+    stars.setStorage(width, 1, GL_RGB8);
+    result.setStorage(width, Skybox::Result::levelCount(width), GL_RGB8);
+
+    update();
+}
+
+void Space3d::SkyEditor::setNebula(const size_t index, const Skybox::NebulaLayer& nebula) {
+    auto& layer = layout.nebulas.at(index);
+    if (layer.scale != nebula.scale || layer.offset != nebula.offset) {
+        dirty[index] = true;
+    }
+    layer = nebula;
+    compositeDirty = true;
+}
+
+void Space3d::SkyEditor::addNebula(const Skybox::NebulaLayer& nebula) {
+    layout.nebulas.push_back(nebula);
+    densities.emplace_back();
+    densities.back().setStorage(width, 1, GL_R16F);
+    dirty.push_back(true);
+    compositeDirty = true;
+}
+
+void Space3d::SkyEditor::removeNebula(const size_t index) {
+    layout.nebulas.erase(layout.nebulas.begin() + static_cast<ptrdiff_t>(index));
+    densities.erase(densities.begin() + static_cast<ptrdiff_t>(index));
+    dirty.erase(dirty.begin() + static_cast<ptrdiff_t>(index));
+    compositeDirty = true;
+}
+
+void Space3d::SkyEditor::setStars(const std::vector<Skybox::StarBatch>& stars) {
+    layout.stars = stars;
+    starsDirty = true;
+}
+
+void Space3d::SkyEditor::setParams(const SkyboxParams& params) {
+    this->params = params;
+    dirty.assign(dirty.size(), true);
+    starsDirty = true;
+}
+
+int Space3d::SkyEditor::update() {
+    int rendered = 0;
+    for (size_t i = 0; i < densities.size(); i++) {
+        if (dirty[i]) {
+            skybox.generateDensity(layout.nebulas[i],
+                                   Skybox::Target{GL_TEXTURE_CUBE_MAP, densities[i].get(), 0, 0, width}, params);
+            dirty[i] = false;
+            compositeDirty = true;
+            rendered++;
+        }
+    }
+
+    if (starsDirty) {
+        renderStars();
+        starsDirty = false;
+        compositeDirty = true;
+    }
+
+    if (compositeDirty) {
+        composite();
+        compositeDirty = false;
+    }
+    return rendered;
+}
+
+void Space3d::SkyEditor::renderStars() {
+    Skybox::Layout starsOnly;
+    starsOnly.stars = layout.stars;
+    skybox.generateTile(starsOnly, Skybox::fullView(width),
+                        Skybox::Target{GL_TEXTURE_CUBE_MAP, stars.get(), 0, 0, width}, params);
+}
+
+void Space3d::SkyEditor::composite() {
+    // The stars are copied as they are, the layers are then blended on top of them.
+    GlState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, read.get());
+    GlState::get().bindFramebuffer(GL_DRAW_FRAMEBUFFER, draw.get());
+    for (unsigned int i = 0; i < 6; i++) {
+        GlState::get().framebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, stars.get(), 0);
+        GlState::get().framebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, result.get(), 0);
+        glBlitFramebuffer(0, 0, width, width, 0, 0, width, width, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    draw.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+    GlState::get().viewport(0, 0, width, width);
+    GlState::get().blendFunc(GL_SRC_ALPHA, GL_ONE);
+
+    shader.use();
+    shader.setInt("uDensity", 0);
+    shader.setFloat("uSize", static_cast<float>(width));
+    vao.bind();
+    for (size_t l = 0; l < densities.size(); l++) {
+        const auto& nebula = layout.nebulas[l];
+        densities[l].bind(0);
+        shader.setVec4("uColor", nebula.color);
+        shader.setFloat("uIntensity", nebula.intensity);
+        shader.setFloat("uFalloff", nebula.falloff);
+
+        for (unsigned int i = 0; i < 6; i++) {
+            GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                                GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, result.get(), 0);
+            shader.setInt("uFace", static_cast<int>(i));
+            shader.drawArrays(GL_TRIANGLES, 3);
+        }
+    }
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    skybox.generateMipmaps(result, params.mipFilter);
+}
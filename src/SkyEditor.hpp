@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Shader.hpp"
+#include "Skybox.hpp"
+#include "Vao.hpp"
+
+namespace Space3d {
+// Keeps a skybox editable without generating it again on every change. Each nebula layer keeps
+// its noise density in its own single channel GL_R16F cubemap, the stars are kept in one RGB8
+// cubemap. The result is composited from them by adding the color of every layer on top of
+// the stars, the same as Skybox::generate() does.
+//
+// A change of the color, intensity or falloff of a layer only composites the result again.
+// Only a change of the scale or offset renders the density of that layer again, and a change
+// of the stars renders the stars again. Each layer costs two bytes per texel, 200MB at 4096.
+//
+// Only the cubemap and its mipmaps are kept up to date, there is no irradiance, specular
+// cubemap or light list.
+class SkyEditor {
+public:
+    SkyEditor(const Skybox& skybox, int64_t seed, int width, const SkyboxParams& params = SkyboxParams{},
+              const ProgramCache* cache = nullptr);
+    SkyEditor(const Skybox& skybox, const Skybox::Layout& layout, int width,
+              const SkyboxParams& params = SkyboxParams{}, const ProgramCache* cache = nullptr);
+
+    // The changes are applied by the next update().
+    void setNebula(size_t index, const Skybox::NebulaLayer& nebula);
+    void addNebula(const Skybox::NebulaLayer& nebula);
+    void removeNebula(size_t index);
+    void setStars(const std::vector<Skybox::StarBatch>& stars);
+    // Renders everything again when the nebula time or octaves change.
+    void setParams(const SkyboxParams& params);
+
+    // Renders what changed and composites the result, does nothing when nothing changed.
+    // Returns the number of nebula layers that were rendered.
+    int update();
+
+    const Skybox::Result& getResult() const {
+        return result;
+    }
+    const Skybox::Layout& getLayout() const {
+        return layout;
+    }
+
+private:
+    void renderStars();
+    void composite();
+
+    const Skybox& skybox;
+    SkyboxParams params;
+    Skybox::Layout layout;
+    int width;
+
+    // Indexed the same as layout.nebulas.
+    std::vector<Skybox::Result> densities;
+    // Layers whose density does not match their scale and offset anymore.
+    std::vector<bool> dirty;
+    bool starsDirty;
+    bool compositeDirty;
+
+    Skybox::Result stars;
+    Skybox::Result result;
+
+    Shader shader;
+    // Attribute-less fullscreen triangle.
+    Vao vao;
+    Fbo read;
+    Fbo draw;
+};
+} // namespace Space3d
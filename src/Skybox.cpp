@@ -1,4 +1,12 @@
 #include "Skybox.hpp"
+#include "BlockCompression.hpp"
+#include "CubeMath.hpp"
+#include "GlState.hpp"
+#include "Noise.hpp"
+#include "Parallel.hpp"
+#include "Readback.hpp"
+#include "ResultPool.hpp"
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <glad/glad.h>
@@ -11,6 +19,34 @@
 #include <random>
 #include <stdexcept>
 
+// Octahedral mapping of directions to [-1, 1]^2, the upper hemisphere (z >= 0) is the
+// inner diamond and the lower one is folded over the corners of the square.
+static const char OCTAHEDRAL_SOURCE[] = R"(
+vec2 octahedralSign(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// The lower hemisphere is unfolded with the given signs instead of the signs of the
+// direction, directions just across an edge of the square continue outside of it.
+vec2 octahedralEncode(vec3 dir, vec2 signs) {
+    vec3 p = dir / (abs(dir.x) + abs(dir.y) + abs(dir.z));
+    return p.z >= 0.0 ? p.xy : (1.0 - p.yx * signs.yx) * signs;
+}
+
+vec2 octahedralEncode(vec3 dir) {
+    return octahedralEncode(dir, octahedralSign(dir.xy));
+}
+
+// Point on the octahedron |x| + |y| + |z| = 1, not normalized.
+vec3 octahedralDecode(vec2 e) {
+    vec3 p = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (p.z < 0.0) {
+        p.xy = (1.0 - abs(p.yx)) * octahedralSign(p.xy);
+    }
+    return p;
+}
+)";
+
 static const std::string SKYBOX_STARS_FRAG = R"(#version 330 core
 out vec4 fragmentColor;
 
@@ -24,13 +60,14 @@ void main() {
 }
 )";
 
-static const std::string SKYBOX_STARS_GEOM = R"(#version 330 core
+static const std::string SKYBOX_STARS_GEOM = std::string("#version 330 core\n") + OCTAHEDRAL_SOURCE + R"(
 layout (points) in;
 layout (triangle_strip) out;
-layout (max_vertices = 4) out;
+layout (max_vertices = 12) out;
 
 in float g_brightness[];
 in vec4 g_color[];
+in float g_layer[];
 
 out vec2 v_coords;
 out float v_brightness;
@@ -38,9 +75,66 @@ out vec4 v_color;
 
 uniform mat4 projectionMatrix;
 uniform vec2 particleSize;
+uniform int uFace;
+uniform bool uOctahedral;
+
+const vec2 CORNERS[4] = vec2[4](vec2(-1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, -1.0), vec2(1.0, 1.0));
+
+void emitOctahedral(vec2 corners[4]) {
+    for (int i = 0; i < 4; i++) {
+        gl_Position = vec4(corners[i], 0.0, 1.0);
+        v_coords = CORNERS[i];
+        v_brightness = g_brightness[0];
+        v_color = g_color[0];
+        gl_Layer = 0;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+
+// The billboard is spanned around the star direction and each corner is mapped on its
+// own. A star across an edge of the square is drawn once more, mirrored over that edge.
+void renderOctahedral(vec3 P) {
+    vec3 dir = normalize(P);
+    vec3 up = abs(dir.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, dir));
+    vec3 bitangent = cross(dir, tangent);
+    vec2 signs = octahedralSign(dir.xy);
+
+    vec2 corners[4];
+    vec2 outside = vec2(-1.0);
+    for (int i = 0; i < 4; i++) {
+        vec3 corner = P + tangent * CORNERS[i].x * particleSize.x + bitangent * CORNERS[i].y * particleSize.y;
+        corners[i] = octahedralEncode(corner, signs);
+        outside = max(outside, abs(corners[i]) - 1.0);
+    }
+    emitOctahedral(corners);
+
+    if (outside.x > 0.0) {
+        vec2 mirrored[4];
+        for (int i = 0; i < 4; i++) {
+            mirrored[i] = vec2(2.0 * signs.x - corners[i].x, -corners[i].y);
+        }
+        emitOctahedral(mirrored);
+    }
+    if (outside.y > 0.0) {
+        vec2 mirrored[4];
+        for (int i = 0; i < 4; i++) {
+            mirrored[i] = vec2(-corners[i].x, 2.0 * signs.y - corners[i].y);
+        }
+        emitOctahedral(mirrored);
+    }
+}
 
 void main (void) {
     vec4 P = gl_in[0].gl_Position;
+    if (uOctahedral) {
+        renderOctahedral(P.xyz);
+        return;
+    }
+
+    // Only used when rendering into all layer-faces of a cubemap array at once.
+    int layer = int(g_layer[0]) * 6 + uFace;
 
     v_brightness = g_brightness[0];
     v_color = g_color[0];
@@ -49,24 +143,28 @@ void main (void) {
     vec2 va = P.xy + vec2(-1.0, -1.0) * particleSize;
     gl_Position = projectionMatrix * vec4(va, P.zw);
     v_coords = vec2(-1.0, -1.0);
+    gl_Layer = layer;
     EmitVertex();  
     
     // b: left-top
     vec2 vb = P.xy + vec2(-1.0, 1.0) * particleSize;
     gl_Position = projectionMatrix * vec4(vb, P.zw);
     v_coords = vec2(-1.0, 1.0);
+    gl_Layer = layer;
     EmitVertex();  
     
     // d: right-bottom
     vec2 vd = P.xy + vec2(1.0, -1.0) * particleSize;
     gl_Position = projectionMatrix * vec4(vd, P.zw);
     v_coords = vec2(1.0, -1.0);
+    gl_Layer = layer;
     EmitVertex();  
 
     // c: right-top
     vec2 vc = P.xy + vec2(1.0, 1.0) * particleSize;
     gl_Position = projectionMatrix * vec4(vc, P.zw);
     v_coords = vec2(1.0, 1.0);
+    gl_Layer = layer;
     EmitVertex();  
 
     EndPrimitive();  
@@ -77,21 +175,24 @@ static const std::string SKYBOX_STARS_VERT = R"(#version 330 core
 layout(location = 0) in vec3 position;
 layout(location = 1) in float brightness;
 layout(location = 2) in vec4 color;
+layout(location = 3) in float layer;
 
 uniform mat4 viewMatrix;
 
 out float g_brightness;
 out vec4 g_color;
+out float g_layer;
 
 void main() {
     g_brightness = brightness;
     g_color = color;
+    g_layer = layer;
     gl_Position = viewMatrix * vec4(position, 1.0);
 }
 )";
 
 // The following shader is based on space-3d shader by wwwtyro from https://github.com/wwwtyro/space-3d
-static const std::string SKYBOX_NEBULA_FRAG = R"(#version 330 core
+static const std::string SKYBOX_NEBULA_FRAG = std::string("#version 330 core\n") + OCTAHEDRAL_SOURCE + R"(
 // Source: https://github.com/wwwtyro/space-3d/blob/gh-pages/src/glsl/nebula.glsl
 // created by: github.com/wwwtyro
 // edited by: github.com/matusnovak
@@ -101,8 +202,20 @@ uniform vec3 uOffset;
 uniform float uScale;
 uniform float uIntensity;
 uniform float uFalloff;
+uniform float uTexelSize;
+uniform float uTexelsPerCell;
+uniform float uMaxOctaves;
+uniform int uPass;
+uniform samplerCube uCoarse;
+uniform float uCoarseTexelSize;
+uniform float uThreshold;
+uniform bool uUseLowFrequency;
+uniform samplerCube uLowFrequency;
+uniform bool uOctahedral;
+uniform float uTime;
 
 in vec3 v_position;
+in vec2 v_octahedral;
 
 out vec4 fragmentColor;
 
@@ -409,30 +522,114 @@ float pnoise(vec4 P, vec4 rep)
   return 2.2 * n_xyzw;
 }
 
+// The fourth axis of the noise is the time, an animated nebula moves along it.
+// src/Noise.cpp has a CPU port of the noise and of nebula(), keep them in sync.
 float noise(vec3 p) {
-    return 0.5 * cnoise(vec4(p, 0)) + 0.5;
+    return 0.5 * cnoise(vec4(p, uTime)) + 0.5;
 }
 
-float nebula(vec3 p) {
-    const int steps = 6;
-    float scale = pow(2.0, float(steps));
-    vec3 displace;
-    for (int i = 0; i < steps; i++) {
-        displace = vec3(
-            noise(p.xyz * scale + displace),
-            noise(p.yzx * scale + displace),
-            noise(p.zxy * scale + displace)
-        );
-        scale *= 0.5;
+const int MAX_OCTAVES = 10;
+
+// Point of the sky this fragment shows, on the cube or on the octahedron. Both map a
+// texel to the solid angle of its footprint times the inverse cube of this length.
+vec3 skyPosition() {
+    return uOctahedral ? octahedralDecode(v_octahedral) : v_position;
+}
+
+// Number of octaves this texel can resolve, derived from its solid angle. Octaves whose
+// noise cells span fewer than uTexelsPerCell texels only alias, so they are faded out.
+float octaveCount(float scale) {
+    // The solid angle of a cubemap texel falls off with the cube of its distance from
+    // the face center, its footprint with the square root of that.
+    float footprint = uTexelSize / pow(length(skyPosition()), 1.5);
+    return clamp(log2(1.0 / (uTexelsPerCell * footprint * scale)), 1.0, min(uMaxOctaves, float(MAX_OCTAVES)));
+}
+
+// Octaves up to this one vary slowly enough to be evaluated at a reduced resolution.
+const int LOW_FREQUENCY_OCTAVES = 3;
+
+// Domain warps p through the octaves from first down to last, octave i has a scale of 2^i.
+vec3 displacement(vec3 p, int first, int last, float octaves, vec3 displace) {
+    for (int i = first; i >= last; i--) {
+        // The finest octave is blended in by its fractional part to avoid popping at the cutoff.
+        float weight = clamp(octaves - float(i) + 1.0, 0.0, 1.0);
+        if (weight > 0.0) {
+            float scale = exp2(float(i));
+            displace = mix(displace, vec3(
+                noise(p.xyz * scale + displace),
+                noise(p.yzx * scale + displace),
+                noise(p.zxy * scale + displace)
+            ), weight);
+        }
     }
-    return noise(p * scale + displace);
+    return displace;
+}
+
+float nebula(vec3 p, float octaves) {
+    return noise(p + displacement(p, MAX_OCTAVES, 1, octaves, vec3(0.0)));
+}
+
+// Only the fine octaves are evaluated here. Their displacement shifts the lookup into
+// the low frequency part of the nebula that was rendered at a lower resolution.
+float nebulaLowFrequency(vec3 dir, float octaves) {
+    vec3 p = dir * uScale + uOffset;
+    vec3 displace = displacement(p, MAX_OCTAVES, LOW_FREQUENCY_OCTAVES + 1, octaves, vec3(0.0));
+    vec3 shifted = dir + displace / (exp2(float(LOW_FREQUENCY_OCTAVES)) * uScale);
+    return textureLod(uLowFrequency, shifted, 0.0).r;
+}
+
+const int PASS_FULL = 0;
+const int PASS_COARSE = 1;
+const int PASS_MASKED = 2;
+const int PASS_LOW_FREQUENCY = 3;
+const int PASS_DENSITY = 4;
+
+// The finest octaves move the density of a texel away from the coarse estimate. The margin
+// is a factor on the density, the falloff raises it to a power on the contribution. With the
+// default falloff of 3 to 6 a tile is only skipped below about a tenth of the threshold.
+const float COARSE_DENSITY_MARGIN = 1.5;
+
+// Largest coarse estimate of the layer contribution around this texel. The neighbouring
+// tiles are included because the coarse pass does not see the finest octaves.
+float coarseContribution(vec3 dir) {
+    vec3 up = abs(dir.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, dir)) * uCoarseTexelSize;
+    vec3 bitangent = cross(dir, tangent);
+    float result = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            result = max(result, textureLod(uCoarse, dir + tangent * float(x) + bitangent * float(y), 0.0).r);
+        }
+    }
+    return result;
 }
 
 void main() {
-    vec3 posn = normalize(v_position) * uScale;
-    float c = min(1.0, nebula(posn + uOffset) * uIntensity);
+    vec3 dir = normalize(skyPosition());
+    if (uPass == PASS_MASKED && coarseContribution(dir) * pow(COARSE_DENSITY_MARGIN, uFalloff) < uThreshold) {
+        discard;
+    }
+
+    vec3 posn = dir * uScale;
+    if (uPass == PASS_LOW_FREQUENCY) {
+        vec3 p = posn + uOffset;
+        fragmentColor = vec4(noise(p + displacement(p, LOW_FREQUENCY_OCTAVES, 1, float(MAX_OCTAVES), vec3(0.0))));
+        return;
+    }
+
+    float octaves = octaveCount(uScale);
+    float n = uUseLowFrequency ? nebulaLowFrequency(dir, octaves) : nebula(posn + uOffset, octaves);
+    if (uPass == PASS_DENSITY) {
+        fragmentColor = vec4(n, 0.0, 0.0, 1.0);
+        return;
+    }
+    float c = min(1.0, n * uIntensity);
     c = pow(c, uFalloff);
-    fragmentColor = vec4(uColor.xyz, c);
+    if (uPass == PASS_COARSE) {
+        fragmentColor = vec4(c, 0.0, 0.0, 1.0);
+    } else {
+        fragmentColor = vec4(uColor.xyz, c);
+    }
 }
 )";
 
@@ -441,10 +638,22 @@ layout(location = 0) in vec3 position;
 
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform bool uOctahedral;
 
 out vec3 v_position;
+out vec2 v_octahedral;
 
 void main() {
+    if (uOctahedral) {
+        // Fullscreen triangle, every fragment decodes its own direction.
+        vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+        v_position = vec3(0.0);
+        v_octahedral = p;
+        gl_Position = vec4(p, 0.0, 1.0);
+        return;
+    }
+
+    v_octahedral = vec2(0.0);
     vec4 worldPos = vec4(position, 1);
     v_position = worldPos.xyz;
     gl_Position = projectionMatrix * viewMatrix * worldPos;
@@ -494,33 +703,107 @@ static const std::array<glm::mat4, 6> CAPTURE_VIEWS = {
     glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
     glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))};
 
-struct StarVertex {
-    glm::vec3 position;
-    float brightness;
-    glm::vec4 color;
-};
+// Must match the PASS_ constants in the nebula shader.
+static const int NEBULA_PASS_FULL = 0;
+static const int NEBULA_PASS_COARSE = 1;
+static const int NEBULA_PASS_MASKED = 2;
+static const int NEBULA_PASS_LOW_FREQUENCY = 3;
+static const int NEBULA_PASS_DENSITY = 4;
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// Below this coarse width the nebula pre-pass costs more than it can save.
+static const int COARSE_MIN_WIDTH = 8;
+
+// Client format and type for allocating texture levels without glTexStorage2D,
+// no pixel data is uploaded with them.
+static void pixelFormat(const GLenum internalFormat, GLenum& format, GLenum& type) {
+    switch (internalFormat) {
+    case GL_R8:
+        format = GL_RED;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_R16F:
+    case GL_R32F:
+        format = GL_RED;
+        type = GL_FLOAT;
+        break;
+    case GL_RGB8:
+        format = GL_RGB;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_RGB16F:
+    case GL_RGB32F:
+        format = GL_RGB;
+        type = GL_FLOAT;
+        break;
+    case GL_RGBA16F:
+    case GL_RGBA32F:
+        format = GL_RGBA;
+        type = GL_FLOAT;
+        break;
+    case GL_RGBA16UI:
+        format = GL_RGBA_INTEGER;
+        type = GL_UNSIGNED_SHORT;
+        break;
+    default:
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+        break;
+    }
+}
 
-Space3d::Skybox::Result::Result() : ref(0) {
+static bool hasTextureStorage() {
+    return GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage;
+}
+
+Space3d::Skybox::Result::Result()
+    : ref(0), target(GL_TEXTURE_CUBE_MAP), width(0), levels(0), layers(0), internalFormat(0) {
+    irradiance.fill(glm::vec3{0.0f});
     glGenTextures(1, &ref);
 }
 
 Space3d::Skybox::Result::~Result() {
     if (ref) {
-        glDeleteTextures(1, &ref);
+        GlState::get().deleteTexture(ref);
     }
 }
 
-void Space3d::Skybox::Result::bind() const {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, ref);
+void Space3d::Skybox::Result::bind(const GLuint unit) const {
+    GlState::get().bindTexture(unit, target, ref);
 }
 
-void Space3d::Skybox::Result::setStorage(const int width, const GLenum internalFormat, const GLenum format,
-                                         const GLenum type) {
+void Space3d::Skybox::Result::setStorage(const int width, const int levels, const GLenum internalFormat) {
+    this->width = width;
+    this->levels = levels;
+    this->internalFormat = internalFormat;
     bind();
-    for (int i = 0; i < 6; i++) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, width, width, 0, format, type, nullptr);
+
+    // Immutable storage for all levels at once, the driver never has to reallocate it.
+    if (hasTextureStorage()) {
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, width, width);
+    } else {
+        GLenum format;
+        GLenum type;
+        pixelFormat(internalFormat, format, type);
+
+        for (int level = 0; level < levels; level++) {
+            const int size = std::max(width >> level, 1);
+            for (int i = 0; i < 6; i++) {
+                if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+                    glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, internalFormat, size, size, 0,
+                                           static_cast<GLsizei>(bc1Size(size, size)), nullptr);
+                } else {
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, internalFormat, size, size, 0, format,
+                                 type, nullptr);
+                }
+            }
+        }
     }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -530,23 +813,152 @@ void Space3d::Skybox::Result::setStorage(const int width, const GLenum internalF
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
+void Space3d::Skybox::Result::setTileStorage(const int width, const GLenum internalFormat) {
+    setTextureStorage(width, 1, internalFormat);
+}
+
+void Space3d::Skybox::Result::setTextureStorage(const int width, const int levels, const GLenum internalFormat) {
+    this->target = GL_TEXTURE_2D;
+    this->width = width;
+    this->levels = levels;
+    this->internalFormat = internalFormat;
+    bind();
+
+    if (hasTextureStorage()) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, width);
+    } else {
+        GLenum format;
+        GLenum type;
+        pixelFormat(internalFormat, format, type);
+
+        for (int level = 0; level < levels; level++) {
+            const int size = std::max(width >> level, 1);
+            if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, size, size, 0,
+                                       static_cast<GLsizei>(bc1Size(size, size)), nullptr);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, level, internalFormat, size, size, 0, format, type, nullptr);
+            }
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Space3d::Skybox::Result::setArrayStorage(const int width, const int levels, const int layers,
+                                              const GLenum internalFormat) {
+    this->target = GL_TEXTURE_CUBE_MAP_ARRAY;
+    this->width = width;
+    this->levels = levels;
+    this->layers = layers;
+    this->internalFormat = internalFormat;
+    bind();
+
+    if (hasTextureStorage()) {
+        glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, levels, internalFormat, width, width, layers * 6);
+    } else {
+        GLenum format;
+        GLenum type;
+        pixelFormat(internalFormat, format, type);
+
+        for (int level = 0; level < levels; level++) {
+            const int size = std::max(width >> level, 1);
+            glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, internalFormat, size, size, layers * 6, 0, format, type,
+                         nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
 void Space3d::Skybox::Result::generateMipmaps() {
     bind();
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenerateMipmap(target);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Space3d::Skybox::Result::compressBc1(Result& target) const {
+    // All faces and levels are copied with a single fence instead of a stall per face.
+    Readback readback(1);
+    readback.read(readback.request(*this), [&](const std::vector<Readback::Image>& images) {
+        target.bind();
+        for (const auto& image : images) {
+            const auto blocks = Space3d::compressBc1(image.data, image.width, image.width);
+            const GLenum face = target.getTarget() == GL_TEXTURE_2D ? GL_TEXTURE_2D : CUBEMAP_ENUMS[image.face];
+            glCompressedTexSubImage2D(face, image.level, 0, 0, image.width, image.width,
+                                      GL_COMPRESSED_RGB_S3TC_DXT1_EXT, static_cast<GLsizei>(blocks.size()),
+                                      blocks.data());
+        }
+    });
+
+    target.bind();
+    glTexParameteri(target.getTarget(), GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+}
+
+void Space3d::Skybox::Result::setImage(const unsigned int face, const int level, const void* data,
+                                       const size_t size) {
+    bind();
+    const GLenum image = target == GL_TEXTURE_2D ? GL_TEXTURE_2D : CUBEMAP_ENUMS[face];
+    const int levelWidth = std::max(width >> level, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) {
+        glCompressedTexSubImage2D(image, level, 0, 0, levelWidth, levelWidth, internalFormat,
+                                  static_cast<GLsizei>(size), data);
+    } else {
+        GLenum format;
+        GLenum type;
+        Readback::transferFormat(internalFormat, format, type);
+        glTexSubImage2D(image, level, 0, 0, levelWidth, levelWidth, format, type, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+int Space3d::Skybox::Result::levelCount(const int width) {
+    int levels = 1;
+    while ((width >> levels) > 0) {
+        levels++;
+    }
+    return levels;
 }
 
 void Space3d::Skybox::Result::release() {
     ref = 0;
 }
 
-Space3d::Skybox::Result::Result(Result&& other) noexcept : ref(0) {
+Space3d::Skybox::Result::Result(Result&& other) noexcept
+    : ref(0), target(GL_TEXTURE_CUBE_MAP), width(0), levels(0), layers(0), internalFormat(0) {
+    irradiance.fill(glm::vec3{0.0f});
     swap(other);
 }
 
 void Space3d::Skybox::Result::swap(Result& other) noexcept {
     std::swap(ref, other.ref);
+    std::swap(target, other.target);
+    std::swap(width, other.width);
+    std::swap(levels, other.levels);
+    std::swap(layers, other.layers);
+    std::swap(internalFormat, other.internalFormat);
+    std::swap(irradiance, other.irradiance);
+    std::swap(specular, other.specular);
+    std::swap(lights, other.lights);
+}
+
+void Space3d::Skybox::Result::setSpecular(std::unique_ptr<Result> specular) {
+    this->specular = std::move(specular);
+}
+
+std::unique_ptr<Space3d::Skybox::Result> Space3d::Skybox::Result::takeSpecular() {
+    return std::move(specular);
 }
 
 Space3d::Skybox::Result& Space3d::Skybox::Result::operator=(Result&& other) noexcept {
@@ -556,9 +968,10 @@ Space3d::Skybox::Result& Space3d::Skybox::Result::operator=(Result&& other) noex
     return *this;
 }
 
-Space3d::Skybox::Skybox()
-    : shaderStars(SKYBOX_STARS_VERT, SKYBOX_STARS_FRAG, SKYBOX_STARS_GEOM),
-      shaderNebula(SKYBOX_NEBULA_VERT, SKYBOX_NEBULA_FRAG, std::nullopt) {
+Space3d::Skybox::Skybox(const ProgramCache* cache)
+    : shaderStars(SKYBOX_STARS_VERT, SKYBOX_STARS_FRAG, SKYBOX_STARS_GEOM, cache),
+      shaderNebula(SKYBOX_NEBULA_VERT, SKYBOX_NEBULA_FRAG, std::nullopt, cache), mipChain(cache),
+      irradiance(cache), prefilter(cache), pool(nullptr) {
 
     meshSkybox.vao.bind();
     meshSkybox.vbo.bind();
@@ -567,73 +980,436 @@ Space3d::Skybox::Skybox()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 }
 
+void Space3d::Skybox::attach(const Target& target, const unsigned int face) {
+    if (target.target == GL_TEXTURE_2D) {
+        // A single tile of a face, the face is given by the view.
+        GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture,
+                                            target.level);
+    } else if (target.target == GL_TEXTURE_CUBE_MAP_ARRAY) {
+        // Layer-faces of a cubemap array are ordered layer major, six faces per layer.
+        GlState::get().framebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, target.level,
+                                               target.layer * 6 + static_cast<int>(face));
+    } else {
+        GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, CUBEMAP_ENUMS[face], target.texture,
+                                            target.level);
+    }
+}
+
+void Space3d::Skybox::setResultPool(ResultPool* pool) {
+    this->pool = pool;
+}
+
+Space3d::Skybox::Result Space3d::Skybox::acquire(const int width, const int levels,
+                                                 const GLenum internalFormat) const {
+    if (pool) {
+        return pool->acquire(width, levels, internalFormat);
+    }
+    Result result;
+    result.setStorage(width, levels, internalFormat);
+    return result;
+}
+
+void Space3d::Skybox::recycle(Result&& result) const {
+    if (pool) {
+        pool->recycle(std::move(result));
+    }
+}
+
 // The following algorithm is based on space-3d by wwwtyro from https://github.com/wwwtyro/space-3d
 // With minor adjustments, such as using geometry shader to create star billboards instead
 // of creating them manually.
-Space3d::Skybox::Result Space3d::Skybox::generate(const int64_t seed, const int width) const {
+Space3d::Skybox::Layout Space3d::Skybox::createLayout(const int64_t seed, const SkyboxParams& params) {
     std::mt19937_64 rng(seed);
+    Layout layout;
+
+    // First, create some random stars as points.
+    for (const auto& stars : params.stars) {
+        std::uniform_real_distribution<float> distPosition(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> distColor(stars.color.min, stars.color.max);
+        std::uniform_real_distribution<float> distBrightness(stars.brightness.min, stars.brightness.max);
+
+        StarBatch batch;
+        batch.particleSize = stars.particleSize;
+        batch.vertices.resize(stars.count);
+
+        for (auto& star : batch.vertices) {
+            star.position = normalize((glm::vec3{distPosition(rng), distPosition(rng), distPosition(rng)})) * 100.0f;
+            star.color = glm::vec4{distColor(rng), distColor(rng), distColor(rng), 1.0f};
+            star.brightness = distBrightness(rng);
+        }
+
+        layout.stars.push_back(std::move(batch));
+    }
+
+    // Then the nebula layers, each following layer has the continuation chance.
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::uniform_real_distribution<float> distScale(params.nebulaScale.min, params.nebulaScale.max);
+    std::uniform_real_distribution<float> distIntensity(params.nebulaIntensity.min, params.nebulaIntensity.max);
+    std::uniform_real_distribution<float> distFalloff(params.nebulaFalloff.min, params.nebulaFalloff.max);
+    std::uniform_real_distribution<float> distOffset(params.nebulaOffset.min, params.nebulaOffset.max);
+
+    while (static_cast<int>(layout.nebulas.size()) < params.maxNebulaLayers) {
+        NebulaLayer nebula;
+        nebula.scale = distScale(rng);
+        nebula.intensity = distIntensity(rng);
+        nebula.color = glm::vec4{dist(rng), dist(rng), dist(rng), 1.0f};
+        nebula.falloff = distFalloff(rng);
+        nebula.offset = glm::vec3{distOffset(rng), distOffset(rng), distOffset(rng)};
+        layout.nebulas.push_back(nebula);
+
+        if (dist(rng) < 1.0f - params.nebulaContinuation) {
+            break;
+        }
+    }
+
+    return layout;
+}
+
+static float luminance(const glm::vec3& color) {
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+float Space3d::Skybox::nebulaAlpha(const NebulaLayer& nebula, const glm::vec3& direction, const float octaves,
+                                   const float time) {
+    const float n = nebulaDensity(direction * nebula.scale + nebula.offset, octaves, time);
+    return std::pow(std::min(1.0f, n * nebula.intensity), nebula.falloff);
+}
+
+glm::vec3 Space3d::Skybox::starIntensity(const StarBatch& batch, const StarVertex& star) {
+    // The star shader writes color * brightness * sqrt(1 - r) and its alpha is blended with GL_SRC_ALPHA,
+    // so a star adds color.rgb * color.a * brightness^2 * (1 - r), which integrates to pi / 3 over a disc.
+    // A billboard of half size p at the distance of 100 covers (p / 100)^2 steradians per unit of its quad.
+    const float solidAngle =
+        glm::pi<float>() / 3.0f * batch.particleSize.x * batch.particleSize.y / (100.0f * 100.0f);
+    return glm::vec3(star.color) * star.color.w * star.brightness * star.brightness * solidAngle;
+}
+
+std::vector<Space3d::Skybox::Light> Space3d::Skybox::createLights(const Layout& layout, const SkyboxParams& params) {
+    std::vector<Light> lights;
+
+    for (const auto& batch : layout.stars) {
+        for (const auto& star : batch.vertices) {
+            lights.push_back(
+                Light{Light::Type::Star, glm::normalize(star.position), starIntensity(batch, star), 1.0f});
+        }
+    }
+
+    // A nebula layer adds its color weighted by the density to the sky. The density is summed
+    // per row of texels into its own slot, weighted by the solid angle of each texel.
+    const int width = std::max(params.lightSampleWidth, 1);
+    const float texel = 2.0f / static_cast<float>(width);
+    std::vector<glm::vec4> rows(6 * static_cast<size_t>(width));
+    for (const auto& nebula : layout.nebulas) {
+        parallelFor(rows.size(), [&](const size_t begin, const size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                const auto face = static_cast<unsigned int>(row / width);
+                const float t0 = -1.0f + static_cast<float>(row % width) * texel;
+                const float t1 = t0 + texel;
+
+                glm::vec4 sum(0.0f);
+                for (int x = 0; x < width; x++) {
+                    const float s0 = -1.0f + static_cast<float>(x) * texel;
+                    const float s1 = s0 + texel;
+                    const float solidAngle = faceAreaElement(s0, t0) - faceAreaElement(s0, t1) -
+                                             faceAreaElement(s1, t0) + faceAreaElement(s1, t1);
+
+                    float dir[3];
+                    faceDirection(face, (s0 + s1) * 0.5f, (t0 + t1) * 0.5f, dir);
+                    const glm::vec3 d = glm::normalize(glm::vec3{dir[0], dir[1], dir[2]});
+                    const float c = nebulaAlpha(nebula, d, params.lightOctaves, params.nebulaTime);
+                    sum += glm::vec4(d * (c * solidAngle), c * solidAngle);
+                }
+                rows[row] = sum;
+            }
+        });
+
+        glm::vec4 total(0.0f);
+        for (const auto& row : rows) {
+            total += row;
+        }
+        if (total.w <= 0.0f) {
+            continue;
+        }
+
+        const glm::vec3 mean = glm::vec3(total) / total.w;
+        const float concentration = glm::length(mean);
+        const glm::vec3 direction = concentration > 0.0f ? mean / concentration : glm::vec3{0.0f, 0.0f, 1.0f};
+        lights.push_back(Light{Light::Type::Nebula, direction, glm::vec3(nebula.color) * total.w, concentration});
+    }
+
+    const size_t count = std::min(static_cast<size_t>(std::max(params.lightCount, 0)), lights.size());
+    std::partial_sort(lights.begin(), lights.begin() + count, lights.end(), [](const Light& a, const Light& b) {
+        return luminance(a.intensity) > luminance(b.intensity);
+    });
+    lights.resize(count);
+    return lights;
+}
+
+Space3d::Skybox::Result Space3d::Skybox::generate(const int64_t seed, const int width,
+                                                  const SkyboxParams& params) const {
+    if (params.mapping == SkyboxParams::Mapping::Octahedral) {
+        return generateOctahedral(seed, width, params);
+    }
 
     // Cube map that will hold the final skybox texture
+    const auto layout = createLayout(seed, params);
+    Result result = acquire(width, Result::levelCount(width), GL_RGB8);
+    generateInto(layout, Target{GL_TEXTURE_CUBE_MAP, result.get(), 0, 0, width}, params);
+
+    // Only depends on the layout, the CPU works on it while the GPU renders.
+    std::vector<Light> lights;
+    if (params.lightCount > 0) {
+        lights = createLights(layout, params);
+    }
+
+    // Generate cubemap mipmaps, filtered across the face edges.
+    mipChain.generate(result.get(), width, result.getLevels(), params.mipFilter);
+
+    // Projected from the uncompressed sky, before any compression.
+    if (params.irradiance) {
+        result.setIrradiance(irradiance.project(result.get(), width, result.getLevels()));
+    }
+
+    // Also from the uncompressed sky, reading its mip chain.
+    std::unique_ptr<Result> specular;
+    if (params.specularWidth > 0) {
+        const int levels = std::min(params.specularLevels, Result::levelCount(params.specularWidth));
+        specular = std::make_unique<Result>(acquire(params.specularWidth, levels, GL_RGB16F));
+        prefilter.generate(result.get(), width, specular->get(), params.specularWidth, levels,
+                           params.specularSamples);
+    }
+
+    if (params.compression == SkyboxParams::Compression::Bc1) {
+        if (GLAD_GL_EXT_texture_compression_s3tc) {
+            Result compressed = acquire(width, result.getLevels(), GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+            result.compressBc1(compressed);
+            compressed.setIrradiance(result.getIrradiance());
+            recycle(std::move(result));
+            result = std::move(compressed);
+        } else {
+            std::cerr << "BC1 compression is not supported by the driver, keeping RGB8" << std::endl;
+        }
+    }
+
+    result.setSpecular(std::move(specular));
+    result.setLights(std::move(lights));
+    return result;
+}
+
+Space3d::Skybox::Result Space3d::Skybox::generateOctahedral(const int64_t seed, const int width,
+                                                            const SkyboxParams& params) const {
+    // A single 2D texture with a plain 2D mip chain, the results of this size are not pooled.
     Result result;
-    result.setStorage(width, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+    result.setTextureStorage(width, Result::levelCount(width), GL_RGB8);
+    const Target target{GL_TEXTURE_2D, result.get(), 0, 0, width};
 
-    // Temporary FBO object for rendering
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
-    glDrawBuffers(1, drawBuffers);
-    glViewport(0, 0, width, width);
+    const auto layout = createLayout(seed, params);
+    beginRender(width);
+
+    const glm::vec4 black = {0.0f, 0.0f, 0.0f, 1.0f};
+    attach(target, 0);
+    glClearBufferfv(GL_COLOR, 0, &black[0]);
+
+    const auto view = octahedralView(width);
+    renderStars(target, layout.stars, view);
+    renderNebulas({target}, {&layout}, view, params);
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::vector<Light> lights;
+    if (params.lightCount > 0) {
+        lights = createLights(layout, params);
+    }
+    result.generateMipmaps();
+
+    if (params.compression == SkyboxParams::Compression::Bc1) {
+        if (GLAD_GL_EXT_texture_compression_s3tc) {
+            Result compressed;
+            compressed.setTextureStorage(width, result.getLevels(), GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+            result.compressBc1(compressed);
+            result = std::move(compressed);
+        } else {
+            std::cerr << "BC1 compression is not supported by the driver, keeping RGB8" << std::endl;
+        }
+    }
+
+    result.setLights(std::move(lights));
+    return result;
+}
+
+void Space3d::Skybox::generateInto(const int64_t seed, const Target& target, const SkyboxParams& params) const {
+    generateInto(createLayout(seed, params), target, params);
+}
+
+void Space3d::Skybox::generateInto(const Layout& layout, const Target& target, const SkyboxParams& params) const {
+    beginRender(target.width);
 
     // Clear FBO texture to all black
     const glm::vec4 black = {0.0f, 0.0f, 0.0f, 1.0f};
     for (unsigned int i = 0; i < 6; ++i) {
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, CUBEMAP_ENUMS[i], result.get(), 0);
+        attach(target, i);
         glClearBufferfv(GL_COLOR, 0, &black[0]);
     }
 
+    const auto view = fullView(target.width);
+    renderStars(target, layout.stars, view);
+    renderNebulas({target}, {&layout}, view, params);
+
+    // Reset the framebuffer to the default one.
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Space3d::Skybox::generateDensity(const NebulaLayer& nebula, const Target& target,
+                                      const SkyboxParams& params) const {
+    beginRender(target.width);
+
+    // The density is added to zero with the usual blending.
+    const glm::vec4 black = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (unsigned int i = 0; i < 6; ++i) {
+        attach(target, i);
+        glClearBufferfv(GL_COLOR, 0, &black[0]);
+    }
+
+    // The coarse pre-pass would mask the texels by the current intensity and falloff.
+    SkyboxParams densityParams = params;
+    densityParams.coarseTileSize = 0;
+
+    const Layout layout{{}, {nebula}};
+    renderNebulas({target}, {&layout}, fullView(target.width), densityParams, true);
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Space3d::Skybox::generateTile(const Layout& layout, const View& view, const Target& target,
+                                   const SkyboxParams& params) const {
+    beginRender(target.width);
+
+    const glm::vec4 black = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (unsigned int i = view.firstFace; i < view.firstFace + view.faceCount; ++i) {
+        attach(target, i);
+        glClearBufferfv(GL_COLOR, 0, &black[0]);
+    }
+
+    // The pre-passes would allocate cubemaps sized after the whole face.
+    SkyboxParams tileParams = params;
+    tileParams.coarseTileSize = 0;
+    tileParams.lowFrequencyMinWidth = 0;
+
+    renderStars(target, layout.stars, view);
+    renderNebulas({target}, {&layout}, view, tileParams);
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+Space3d::Skybox::View Space3d::Skybox::fullView(const int width) {
+    return View{CAPTURE_PROJECTION, 0, 6, width};
+}
+
+Space3d::Skybox::View Space3d::Skybox::octahedralView(const int width) {
+    return View{glm::mat4(1.0f), 0, 1, width, true};
+}
+
+const char* Space3d::Skybox::octahedralSource() {
+    return OCTAHEDRAL_SOURCE;
+}
+
+Space3d::Skybox::View Space3d::Skybox::tileView(const unsigned int face, const int x, const int y, const int size,
+                                                const int faceWidth) {
+    // Scale and shift the clip space so that only the tile ends up in [-1, 1].
+    const float x0 = -1.0f + 2.0f * static_cast<float>(x) / static_cast<float>(faceWidth);
+    const float y0 = -1.0f + 2.0f * static_cast<float>(y) / static_cast<float>(faceWidth);
+    const float extent = 2.0f * static_cast<float>(size) / static_cast<float>(faceWidth);
+
+    glm::mat4 crop(1.0f);
+    crop[0][0] = 2.0f / extent;
+    crop[1][1] = 2.0f / extent;
+    crop[3][0] = -(2.0f * x0 + extent) / extent;
+    crop[3][1] = -(2.0f * y0 + extent) / extent;
+
+    return View{crop * CAPTURE_PROJECTION, face, 1, faceWidth};
+}
+
+Space3d::Skybox::Result Space3d::Skybox::generateBatch(const std::vector<int64_t>& seeds, const int width,
+                                                       const SkyboxParams& params) const {
+    if (seeds.empty()) {
+        throw std::runtime_error("A batch needs at least one seed");
+    }
+    if (!GLAD_GL_VERSION_4_0 && !GLAD_GL_ARB_texture_cube_map_array) {
+        throw std::runtime_error("Cubemap arrays are not supported by the driver");
+    }
+
+    std::vector<Layout> layouts;
+    std::vector<const Layout*> layoutPtrs;
+    std::vector<Target> targets;
+    layouts.reserve(seeds.size());
+
+    Result result;
+    result.setArrayStorage(width, Result::levelCount(width), static_cast<int>(seeds.size()), GL_RGB8);
+
+    for (size_t i = 0; i < seeds.size(); i++) {
+        layouts.push_back(createLayout(seeds[i], params));
+        layoutPtrs.push_back(&layouts.back());
+        targets.push_back(Target{GL_TEXTURE_CUBE_MAP_ARRAY, result.get(), static_cast<int>(i), 0, width});
+    }
+
+    beginRender(width);
+
+    // A layered attachment covers all layer-faces of the array, a single clear is enough.
+    const glm::vec4 black = {0.0f, 0.0f, 0.0f, 1.0f};
+    GlState::get().framebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, result.get(), 0);
+    glClearBufferfv(GL_COLOR, 0, &black[0]);
+
+    renderStarsBatched(layouts);
+    renderNebulas(targets, layoutPtrs, fullView(width), params);
+
+    // Reset the framebuffer to the default one.
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    mipChain.generate(result.get(), width, result.getLevels(), params.mipFilter, result.getLayers());
+    return result;
+}
+
+void Space3d::Skybox::generateMipmaps(Result& result, const SkyboxParams::MipFilter filter) const {
+    mipChain.generate(result.get(), result.getWidth(), result.getLevels(), filter, result.getLayers());
+}
+
+void Space3d::Skybox::beginRender(const int width) const {
+    fbo.bind();
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+    GlState::get().viewport(0, 0, width, width);
+
     // Set the blending mode to add only
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    GlState::get().blendFunc(GL_SRC_ALPHA, GL_ONE);
     glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+}
 
-    // Render the stars
-    struct Params {
-        size_t starsCount;
-        glm::vec2 particleSize;
-    };
-
-    // clang-format off
-    // This is list of star parameters, feel free to add more.
-    std::array<Params, 2> allParams = {
-        // A lot of tiny stars
-        Params{
-            20000ULL,
-            {0.05f, 0.05f}
-        },
-        // Just few more bigger stars
-        Params{
-            100ULL,
-            {0.2f, 0.2f}
-        }
-    };
-    // clang-format on
+// The VBO layout:
+// pos.x, pos.y, pos.z, brightness, color.r, color.g, color.b, color.a
+static void setStarAttributes(const GLsizei stride) {
+    // The VBO stars with a vec3 (positions)
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
 
-    // Loop through the star parameters from above.
-    for (const auto& params : allParams) {
-        // First, create some random stars as points.
-        std::uniform_real_distribution<float> distPosition(-1.0f, 1.0f);
-        std::uniform_real_distribution<float> distColor(0.9f, 1.0f);
-        std::uniform_real_distribution<float> distBrightness(0.7f, 1.0f);
+    // Then it follows with a brightness value.
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, (void*)(1 * sizeof(glm::vec3)));
 
-        std::vector<StarVertex> stars;
-        stars.resize(params.starsCount);
+    // And ends with a vec4 (color)
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(1 * sizeof(glm::vec3) + sizeof(float)));
+}
 
-        for (auto& star : stars) {
-            star.position = normalize((glm::vec3{distPosition(rng), distPosition(rng), distPosition(rng)})) * 100.0f;
-            star.color = glm::vec4{distColor(rng), distColor(rng), distColor(rng), 1.0f};
-            star.brightness = distBrightness(rng);
-        }
+void Space3d::Skybox::renderStars(const Target& target, const std::vector<StarBatch>& batches,
+                                   const View& view) const {
+    // The billboards are expanded before the projection, so stars that cross the
+    // border of a tile are simply clipped.
+    shaderStars.use();
+    shaderStars.setMat4("projectionMatrix", view.projection);
+    shaderStars.setInt("uFace", 0);
+    shaderStars.setInt("uOctahedral", view.octahedral ? 1 : 0);
 
+    for (const auto& batch : batches) {
         // Create a VAO and VBO objects that will hold the star points.
         // The points will be converted to triangle strips via geometry shader.
         Vao vaoStars;
@@ -641,70 +1417,185 @@ Space3d::Skybox::Result Space3d::Skybox::generate(const int64_t seed, const int
 
         Vbo vboStars;
         vboStars.bind();
-        vboStars.bufferData(reinterpret_cast<const uint8_t*>(stars.data()), stars.size() * sizeof(StarVertex));
+        vboStars.bufferData(reinterpret_cast<const uint8_t*>(batch.vertices.data()),
+                            batch.vertices.size() * sizeof(StarVertex));
+        setStarAttributes(sizeof(StarVertex));
+
+        // Render the stars
+        shaderStars.setVec2("particleSize", batch.particleSize);
+
+        // Render for all cubemap sides.
+        for (unsigned int i = view.firstFace; i < view.firstFace + view.faceCount; ++i) {
+            shaderStars.setMat4("viewMatrix", view.octahedral ? glm::mat4(1.0f) : CAPTURE_VIEWS[i]);
 
-        // The VBO stars with a vec3 (positions)
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StarVertex), (void*)0);
+            attach(target, i);
+            shaderStars.drawArrays(GL_POINTS, static_cast<GLsizei>(batch.vertices.size()));
+        }
+    }
+}
 
-        // Then it follows with a brightness value.
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(StarVertex), (void*)(1 * sizeof(glm::vec3)));
+void Space3d::Skybox::renderStarsBatched(const std::vector<Layout>& layouts) const {
+    // The stars of all seeds share one buffer, each vertex also carries the
+    // index of its cubemap in the array.
+    struct LayeredStarVertex {
+        StarVertex star;
+        float layer;
+    };
 
-        // And ends with a vec4 (color)
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(StarVertex),
-                              (void*)(1 * sizeof(glm::vec3) + sizeof(float)));
+    struct Range {
+        GLint first;
+        GLsizei count;
+        glm::vec2 particleSize;
+    };
 
-        // The VBO layout:
-        // pos.x, pos.y, pos.z, brightness, color.r, color.g, color.b, color.a
+    std::vector<LayeredStarVertex> vertices;
+    std::vector<Range> ranges;
+    for (size_t b = 0; b < layouts.front().stars.size(); b++) {
+        Range range = {static_cast<GLint>(vertices.size()), 0, layouts.front().stars[b].particleSize};
+        for (size_t i = 0; i < layouts.size(); i++) {
+            for (const auto& star : layouts[i].stars[b].vertices) {
+                vertices.push_back(LayeredStarVertex{star, static_cast<float>(i)});
+            }
+        }
+        range.count = static_cast<GLsizei>(vertices.size()) - range.first;
+        ranges.push_back(range);
+    }
 
-        // Render the stars
-        shaderStars.use();
-        shaderStars.setMat4("projectionMatrix", CAPTURE_PROJECTION);
-        shaderStars.setVec2("particleSize", params.particleSize);
+    Vao vaoStars;
+    vaoStars.bind();
 
-        // Render for all cubemap sides.
+    Vbo vboStars;
+    vboStars.bind();
+    vboStars.bufferData(reinterpret_cast<const uint8_t*>(vertices.data()),
+                        vertices.size() * sizeof(LayeredStarVertex));
+    setStarAttributes(sizeof(LayeredStarVertex));
+
+    // The geometry shader routes each star into gl_Layer = layer * 6 + face.
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(LayeredStarVertex), (void*)sizeof(StarVertex));
+
+    shaderStars.use();
+    shaderStars.setMat4("projectionMatrix", CAPTURE_PROJECTION);
+    shaderStars.setInt("uOctahedral", 0);
+
+    // One draw per star batch and face covers all seeds.
+    for (const auto& range : ranges) {
+        shaderStars.setVec2("particleSize", range.particleSize);
         for (unsigned int i = 0; i < 6; ++i) {
             shaderStars.setMat4("viewMatrix", CAPTURE_VIEWS[i]);
-
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, CUBEMAP_ENUMS[i], result.get(), 0);
-            shaderStars.drawArrays(GL_POINTS, static_cast<GLsizei>(stars.size()));
+            shaderStars.setInt("uFace", static_cast<int>(i));
+            shaderStars.drawArrays(GL_POINTS, range.first, range.count);
         }
     }
+}
+
+void Space3d::Skybox::renderNebulas(const std::vector<Target>& targets, const std::vector<const Layout*>& layouts,
+                                    const View& view, const SkyboxParams& params, const bool density) const {
+    // All targets have the same size, the detail follows the size of the whole face.
+    const int width = targets.front().width;
+    const int faceWidth = view.faceWidth;
 
-    // Render the nebulas
-    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
     shaderNebula.use();
-    shaderNebula.setMat4("projectionMatrix", CAPTURE_PROJECTION);
+    shaderNebula.setMat4("projectionMatrix", view.projection);
+    shaderNebula.setFloat("uTexelsPerCell", params.texelsPerCell);
+    shaderNebula.setFloat("uMaxOctaves", static_cast<float>(params.maxOctaves));
+    shaderNebula.setFloat("uTime", params.nebulaTime);
     meshSkybox.vao.bind();
 
-    while (true) {
-        shaderNebula.setFloat("uScale", dist(rng) * 0.5f + 0.25f);
-        shaderNebula.setFloat("uIntensity", dist(rng) * 0.2f + 0.9f);
-        shaderNebula.setVec4("uColor", glm::vec4{dist(rng), dist(rng), dist(rng), 1.0f});
-        shaderNebula.setFloat("uFalloff", dist(rng) * 3.0f + 3.0f);
-        shaderNebula.setVec3("uOffset", glm::vec3{dist(rng) * 2000.0f - 1000.0f, dist(rng) * 2000.0f - 1000.0f,
-                                                  dist(rng) * 2000.0f - 1000.0f});
-
-        for (unsigned int i = 0; i < 6; ++i) {
+    // Renders the current nebula layer into the faces of the view.
+    const auto renderNebula = [&](const Target& cubemap, const View& faces) {
+        shaderNebula.setInt("uOctahedral", faces.octahedral ? 1 : 0);
+        if (faces.octahedral) {
+            attach(cubemap, 0);
+            shaderNebula.drawArrays(GL_TRIANGLES, 3);
+            return;
+        }
+        for (unsigned int i = faces.firstFace; i < faces.firstFace + faces.faceCount; ++i) {
             shaderNebula.setMat4("viewMatrix", CAPTURE_VIEWS[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                                   result.get(), 0);
+            attach(cubemap, i);
             shaderNebula.drawArrays(GL_TRIANGLES, 6 * 6);
         }
+    };
 
-        if (dist(rng) < 0.5f) {
-            break;
-        }
+    // Renders the current nebula layer into an intermediate cubemap that is then
+    // bound to the given texture unit for the full resolution pass.
+    const auto renderPrePass = [&](const Result& intermediate, const int targetWidth, const int pass,
+                                   const GLuint unit) {
+        // The target must not be bound while it is being rendered into.
+        GlState::get().bindTexture(unit, GL_TEXTURE_CUBE_MAP, 0);
+        glDisable(GL_BLEND);
+        GlState::get().viewport(0, 0, targetWidth, targetWidth);
+        shaderNebula.setInt("uPass", pass);
+        shaderNebula.setInt("uUseLowFrequency", 0);
+        shaderNebula.setFloat("uTexelSize", 2.0f / static_cast<float>(targetWidth));
+        shaderNebula.setMat4("projectionMatrix", CAPTURE_PROJECTION);
+
+        renderNebula(Target{GL_TEXTURE_CUBE_MAP, intermediate.get(), 0, 0, targetWidth}, fullView(targetWidth));
+
+        shaderNebula.setMat4("projectionMatrix", view.projection);
+        intermediate.bind(unit);
+        glEnable(GL_BLEND);
+        GlState::get().viewport(0, 0, width, width);
+    };
+
+    // Both intermediate cubemaps are sampled across the face edges.
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // Most of a nebula layer is close to black after the falloff. A coarse pre-pass
+    // with one texel per tile estimates the layer contribution, and the full
+    // resolution pass skips the tiles where it would not be visible.
+    const int coarseWidth = params.coarseTileSize > 0 ? faceWidth / params.coarseTileSize : 0;
+    std::optional<Result> coarse;
+    if (coarseWidth >= COARSE_MIN_WIDTH) {
+        coarse = acquire(coarseWidth, 1, GL_R16F);
+        shaderNebula.setInt("uCoarse", 1);
+        shaderNebula.setFloat("uCoarseTexelSize", 2.0f / static_cast<float>(coarseWidth));
+        shaderNebula.setFloat("uThreshold", params.coarseThreshold);
     }
 
-    // Delete the framebuffer and reset it to the default one.
-    glDeleteFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // The low frequency octaves are smooth enough to be upsampled from a smaller
+    // cubemap with linear filtering.
+    const int lowFrequencyWidth = faceWidth / std::max(params.lowFrequencyRatio, 1);
+    std::optional<Result> lowFrequency;
+    if (params.lowFrequencyMinWidth > 0 && faceWidth >= params.lowFrequencyMinWidth) {
+        lowFrequency = acquire(lowFrequencyWidth, 1, GL_R16F);
+        shaderNebula.setInt("uLowFrequency", 2);
+    }
 
-    // Generate cubemap mipmaps.
-    result.generateMipmaps();
+    for (size_t t = 0; t < targets.size(); t++) {
+        for (const auto& nebula : layouts[t]->nebulas) {
+            shaderNebula.setFloat("uScale", nebula.scale);
+            shaderNebula.setFloat("uIntensity", nebula.intensity);
+            shaderNebula.setVec4("uColor", nebula.color);
+            shaderNebula.setFloat("uFalloff", nebula.falloff);
+            shaderNebula.setVec3("uOffset", nebula.offset);
+
+            if (lowFrequency) {
+                renderPrePass(*lowFrequency, lowFrequencyWidth, NEBULA_PASS_LOW_FREQUENCY, 2);
+            }
+            if (coarse) {
+                renderPrePass(*coarse, coarseWidth, NEBULA_PASS_COARSE, 1);
+            }
+
+            if (density) {
+                shaderNebula.setInt("uPass", NEBULA_PASS_DENSITY);
+            } else {
+                shaderNebula.setInt("uPass", coarse ? NEBULA_PASS_MASKED : NEBULA_PASS_FULL);
+            }
+            shaderNebula.setInt("uUseLowFrequency", lowFrequency ? 1 : 0);
+            // Size of a texel at the center of a cubemap face, the shader derives the
+            // number of noise octaves worth evaluating from it.
+            shaderNebula.setFloat("uTexelSize", 2.0f / static_cast<float>(faceWidth));
+
+            renderNebula(targets[t], view);
+        }
+    }
 
-    return result;
+    // The intermediate cubemaps are reused by the next generation.
+    if (coarse) {
+        recycle(std::move(*coarse));
+    }
+    if (lowFrequency) {
+        recycle(std::move(*lowFrequency));
+    }
 }
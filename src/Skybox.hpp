@@ -1,13 +1,40 @@
 #pragma once
+#include "Fbo.hpp"
+#include "Irradiance.hpp"
+#include "MipChain.hpp"
+#include "Prefilter.hpp"
 #include "Shader.hpp"
+#include "SkyboxParams.hpp"
 #include "Vao.hpp"
 #include "Vbo.hpp"
 #include <glad/glad.h>
 #include <memory>
+#include <vector>
 
 namespace Space3d {
+class ResultPool;
+
 class Skybox {
 public:
+    // A light source taken from the layout of a sky, see createLights().
+    struct Light {
+        enum class Type {
+            // A single star, small enough to be a directional light.
+            Star,
+            // The mean direction of a nebula layer, usually too wide for anything but ambient light.
+            Nebula,
+        };
+
+        Type type;
+        // Unit direction towards the light, the same direction the cubemap is sampled with.
+        glm::vec3 direction;
+        // Color of the light in the cubemap summed over the solid angle it covers, in texel values
+        // times steradians. Multiply by the cosine at the surface for its irradiance.
+        glm::vec3 intensity;
+        // Length of the mean direction of the light, 1 for a point and close to 0 for light from all around.
+        float concentration;
+    };
+
     class Result {
     public:
         Result();
@@ -19,23 +46,191 @@ public:
         Result& operator=(const Result& other) = delete;
         Result& operator=(Result&& other) noexcept;
 
-        void setStorage(int width, GLenum internalFormat, GLenum format, GLenum type);
+        // Allocates immutable storage for the given number of mipmap levels, can only be called once.
+        void setStorage(int width, int levels, GLenum internalFormat);
+        // Same as setStorage, but makes this a cubemap array with the given number of cubemaps.
+        void setArrayStorage(int width, int levels, int layers, GLenum internalFormat);
+        // Makes this a single level 2D texture, used as a scratch target for tiles of a face.
+        void setTileStorage(int width, GLenum internalFormat);
+        // Makes this a square 2D texture with the given number of mipmap levels, used for octahedral maps.
+        void setTextureStorage(int width, int levels, GLenum internalFormat);
+        // glGenerateMipmap, it clamps at the face edges. Used for octahedral results, cubemaps go
+        // through Skybox::generateMipmaps().
         void generateMipmaps();
-        void bind() const;
+        // Encodes all levels of this RGB8 cubemap into the storage of a BC1 cubemap of the same size.
+        void compressBc1(Result& target) const;
+        // Uploads one face and level, tightly packed in the layout Readback returns it. BC1 blocks for a
+        // BC1 result, the face is ignored for a 2D texture.
+        void setImage(unsigned int face, int level, const void* data, size_t size);
+        void bind(GLuint unit = 0) const;
         void release();
         GLuint get() const {
             return ref;
         }
+        // GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_ARRAY or GL_TEXTURE_2D
+        GLenum getTarget() const {
+            return target;
+        }
+        int getWidth() const {
+            return width;
+        }
+        int getLevels() const {
+            return levels;
+        }
+        // Number of cubemaps in an array, zero for a single cubemap.
+        int getLayers() const {
+            return layers;
+        }
+        GLenum getInternalFormat() const {
+            return internalFormat;
+        }
+        // Spherical harmonics of the sky, filled by generate() when SkyboxParams::irradiance is set.
+        const ShCoefficients& getIrradiance() const {
+            return irradiance;
+        }
+        void setIrradiance(const ShCoefficients& irradiance) {
+            this->irradiance = irradiance;
+        }
+        // GGX prefiltered cubemap with one roughness per level, filled by generate() when
+        // SkyboxParams::specularWidth is set, otherwise null.
+        const Result* getSpecular() const {
+            return specular.get();
+        }
+        void setSpecular(std::unique_ptr<Result> specular);
+        std::unique_ptr<Result> takeSpecular();
+        // Brightest lights of the sky first, filled by generate() when SkyboxParams::lightCount is set.
+        const std::vector<Light>& getLights() const {
+            return lights;
+        }
+        void setLights(std::vector<Light> lights) {
+            this->lights = std::move(lights);
+        }
+
+        // Number of mipmap levels of a full chain down to 1x1.
+        static int levelCount(int width);
 
     private:
         GLuint ref;
+        GLenum target;
+        int width;
+        int levels;
+        int layers;
+        GLenum internalFormat;
+        ShCoefficients irradiance;
+        std::unique_ptr<Result> specular;
+        std::vector<Light> lights;
     };
 
-    Skybox();
+    struct StarVertex {
+        glm::vec3 position;
+        float brightness;
+        glm::vec4 color;
+    };
 
-    Result generate(int64_t seed, int width) const;
+    struct StarBatch {
+        std::vector<StarVertex> vertices;
+        glm::vec2 particleSize;
+    };
+
+    struct NebulaLayer {
+        float scale;
+        float intensity;
+        glm::vec4 color;
+        float falloff;
+        glm::vec3 offset;
+    };
+
+    // A cubemap owned by the caller, one cubemap of a cubemap array, or a 2D texture for a tile.
+    struct Target {
+        // GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_ARRAY or GL_TEXTURE_2D
+        GLenum target;
+        GLuint texture;
+        // Index of the cubemap within the array, ignored for GL_TEXTURE_CUBE_MAP.
+        int layer;
+        int level;
+        // Width of the faces at the given level.
+        int width;
+    };
+
+    // Everything that is randomly picked from the seed, before any rendering.
+    struct Layout {
+        std::vector<StarBatch> stars;
+        std::vector<NebulaLayer> nebulas;
+    };
+
+    // The faces that are rendered and the projection used for them. A tile of a face
+    // uses an off-center projection that only covers the tile.
+    struct View {
+        glm::mat4 projection;
+        unsigned int firstFace;
+        unsigned int faceCount;
+        // Width of the whole face, it decides the level of detail of the nebulas.
+        int faceWidth;
+        // Renders the whole sphere into one 2D texture in octahedral mapping, see octahedralSource().
+        bool octahedral = false;
+    };
+
+    explicit Skybox(const ProgramCache* cache = nullptr);
+
+    Result generate(int64_t seed, int width, const SkyboxParams& params = SkyboxParams{}) const;
+    // Renders the skybox straight into the level and layer of an existing texture. Nothing is
+    // allocated for the target and no mipmaps are generated, the caller owns the storage.
+    // The compression parameter does not apply here.
+    void generateInto(int64_t seed, const Target& target, const SkyboxParams& params = SkyboxParams{}) const;
+    void generateInto(const Layout& layout, const Target& target, const SkyboxParams& params = SkyboxParams{}) const;
+    // Generates one skybox per seed into the layers of a single cubemap array. The stars of
+    // all seeds are drawn from one shared buffer with a single draw per star batch and face.
+    Result generateBatch(const std::vector<int64_t>& seeds, int width,
+                         const SkyboxParams& params = SkyboxParams{}) const;
+
+    // Renders the faces or the tile of the view into the target. The target is a 2D
+    // texture of the tile size for a tile view. The coarse and low frequency pre-passes
+    // are skipped, their cubemaps would be sized after the whole face.
+    void generateTile(const Layout& layout, const View& view, const Target& target,
+                      const SkyboxParams& params = SkyboxParams{}) const;
+    // Renders the noise density of a single nebula layer into a single channel cubemap, such as
+    // GL_R16F. It is the value before the intensity, falloff and color of the layer are applied,
+    // so those can change without rendering the layer again, see SkyEditor.
+    void generateDensity(const NebulaLayer& nebula, const Target& target,
+                         const SkyboxParams& params = SkyboxParams{}) const;
+    // Fills the mipmaps of a cubemap or cubemap array result from its level 0 with the seam-aware
+    // filter generate() uses, for results rendered into by the caller.
+    void generateMipmaps(Result& result, SkyboxParams::MipFilter filter) const;
+
+    // When set, the generated cubemaps and the intermediate ones are taken from the pool.
+    void setResultPool(ResultPool* pool);
+
+    static Layout createLayout(int64_t seed, const SkyboxParams& params);
+    // The params.lightCount brightest stars and nebula layers of the layout, brightest first. Computed
+    // from the layout alone, the nebulas are sampled on the CPU at params.lightSampleWidth directions
+    // per face edge. Nothing is rendered or read back.
+    static std::vector<Light> createLights(const Layout& layout, const SkyboxParams& params);
+    // Light a star adds to the sky, its color integrated over the solid angle of its billboard.
+    static glm::vec3 starIntensity(const StarBatch& batch, const StarVertex& star);
+    // Alpha the nebula shader writes for the layer in the direction, evaluated on the CPU with the
+    // given number of octaves.
+    static float nebulaAlpha(const NebulaLayer& nebula, const glm::vec3& direction, float octaves, float time);
+    static View fullView(int width);
+    static View octahedralView(int width);
+    // The tile of the given size at texel (x, y) of a face, (0, 0) being the first texel in memory.
+    static View tileView(unsigned int face, int x, int y, int size, int faceWidth);
+    // Attaches one face of the target to the color attachment of the bound framebuffer.
+    static void attach(const Target& target, unsigned int face);
+    // GLSL functions octahedralEncode(vec3 dir) and octahedralDecode(vec2 e) that convert between
+    // directions and [-1, 1]^2, to be pasted into shaders sampling an octahedral result.
+    static const char* octahedralSource();
 
 private:
+    Result generateOctahedral(int64_t seed, int width, const SkyboxParams& params) const;
+    Result acquire(int width, int levels, GLenum internalFormat) const;
+    void recycle(Result&& result) const;
+    void beginRender(int width) const;
+    void renderStars(const Target& target, const std::vector<StarBatch>& batches, const View& view) const;
+    void renderStarsBatched(const std::vector<Layout>& layouts) const;
+    // With density set the layers write their noise density instead of their color, see generateDensity().
+    void renderNebulas(const std::vector<Target>& targets, const std::vector<const Layout*>& layouts,
+                       const View& view, const SkyboxParams& params, bool density = false) const;
+
     struct Mesh {
         Vao vao;
         Vbo vbo;
@@ -43,6 +238,11 @@ private:
 
     Shader shaderStars;
     Shader shaderNebula;
+    MipChain mipChain;
+    Irradiance irradiance;
+    Prefilter prefilter;
     Mesh meshSkybox;
+    Fbo fbo;
+    ResultPool* pool;
 };
 } // namespace Space3d
@@ -0,0 +1,53 @@
+#include "SkyboxParams.hpp"
+#include <stdexcept>
+
+Space3d::SkyboxParams Space3d::SkyboxParams::fromQuality(const Quality quality) {
+    SkyboxParams params;
+    switch (quality) {
+    case Quality::Low:
+        params.texelsPerCell = 32.0f;
+        params.maxOctaves = 6;
+        params.coarseThreshold = 1.0f / 256.0f;
+        params.lowFrequencyMinWidth = 1024;
+        break;
+    case Quality::Medium:
+        params.texelsPerCell = 24.0f;
+        params.maxOctaves = 8;
+        params.coarseThreshold = 1.0f / 512.0f;
+        break;
+    case Quality::High:
+        // The defaults.
+        break;
+    case Quality::Ultra:
+        params.texelsPerCell = 8.0f;
+        params.coarseTileSize = 0;
+        params.lowFrequencyMinWidth = 0;
+        params.mipFilter = MipFilter::Kaiser;
+        params.specularSamples = 128;
+        break;
+    }
+    return params;
+}
+
+Space3d::SkyboxParams::Quality Space3d::SkyboxParams::parseQuality(const std::string& name) {
+    for (const auto quality : {Quality::Low, Quality::Medium, Quality::High, Quality::Ultra}) {
+        if (name == toString(quality)) {
+            return quality;
+        }
+    }
+    throw std::runtime_error("Unknown quality: " + name);
+}
+
+const char* Space3d::SkyboxParams::toString(const Quality quality) {
+    switch (quality) {
+    case Quality::Low:
+        return "low";
+    case Quality::Medium:
+        return "medium";
+    case Quality::High:
+        return "high";
+    case Quality::Ultra:
+        return "ultra";
+    }
+    return "unknown";
+}
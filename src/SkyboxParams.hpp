@@ -0,0 +1,136 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <string>
+#include <vector>
+
+namespace Space3d {
+struct SkyboxParams {
+    enum class Quality {
+        Low,
+        Medium,
+        High,
+        Ultra,
+    };
+
+    enum class Compression {
+        // Uncompressed RGB8, 3 bytes per texel.
+        None,
+        // BC1 (DXT1) encoded on the CPU after generation, half a byte per texel.
+        Bc1,
+    };
+
+    enum class MipFilter {
+        // Averages the 2x2 source texels, the same as glGenerateMipmap.
+        Box,
+        // Kaiser windowed sinc over 6x6 source texels, sharper distant reflections.
+        // The taps continue across the face edges.
+        Kaiser,
+    };
+
+    enum class Mapping {
+        // Six faces of a cubemap.
+        Cubemap,
+        // A single 2D texture, simpler to tile, compress and stream. At the same worst case angular
+        // resolution it has about 5.2 w^2 texels where a cubemap with faces of width w has 6 w^2.
+        Octahedral,
+    };
+
+    struct Range {
+        float min;
+        float max;
+    };
+
+    // A batch of stars drawn as billboards of the same size.
+    struct Stars {
+        size_t count;
+        glm::vec2 particleSize;
+        Range color;
+        Range brightness;
+    };
+
+    // clang-format off
+    // This is list of star parameters, feel free to add more.
+    std::vector<Stars> stars = {
+        // A lot of tiny stars
+        Stars{
+            20000ULL,
+            {0.05f, 0.05f},
+            {0.9f, 1.0f},
+            {0.7f, 1.0f}
+        },
+        // Just few more bigger stars
+        Stars{
+            100ULL,
+            {0.2f, 0.2f},
+            {0.9f, 1.0f},
+            {0.7f, 1.0f}
+        }
+    };
+    // clang-format on
+
+    // Ranges the random parameters of each nebula layer are picked from.
+    Range nebulaScale = {0.25f, 0.75f};
+    Range nebulaIntensity = {0.9f, 1.1f};
+    Range nebulaFalloff = {3.0f, 6.0f};
+    Range nebulaOffset = {-1000.0f, 1000.0f};
+
+    // Chance that another nebula layer follows the previous one.
+    float nebulaContinuation = 0.5f;
+    // Hard cap on the number of nebula layers, keeps the worst case generation time bounded. It
+    // decides the layout of a seed, so it is the same on all quality tiers.
+    int maxNebulaLayers = 16;
+    // Position on the time axis of the nebula noise, see AnimatedSkybox.
+    float nebulaTime = 0.0f;
+
+    // Noise octaves whose cells would span fewer texels than this are not evaluated.
+    float texelsPerCell = 16.0f;
+    // At most 10, the limit of the nebula shader.
+    int maxOctaves = 10;
+
+    // Size of the tiles the coarse nebula pre-pass estimates, zero disables the pre-pass.
+    int coarseTileSize = 16;
+    // Tiles where a nebula layer contributes less than this are skipped. The contribution is an
+    // estimate with a margin, a faint texel can still be skipped, zero tile size is exact.
+    float coarseThreshold = 1.0f / 1024.0f;
+
+    // From this width on the low frequency nebula octaves are rendered at a
+    // resolution reduced by the ratio, zero disables it.
+    int lowFrequencyMinWidth = 2048;
+    int lowFrequencyRatio = 4;
+
+    // Format the final cubemap is stored in, including all of its mipmaps.
+    Compression compression = Compression::None;
+
+    // Layout of the result of Skybox::generate(). The octahedral map gets a plain 2D mip chain,
+    // the mip filter, irradiance and specular options only apply to cubemaps.
+    Mapping mapping = Mapping::Cubemap;
+
+    // Kernel used to build the mip chain of the final cubemap.
+    MipFilter mipFilter = MipFilter::Box;
+
+    // Projects the final cubemap onto L2 spherical harmonics for diffuse lighting,
+    // see Skybox::Result::getIrradiance(). Waits for the generation to finish.
+    bool irradiance = true;
+
+    // Width of the GGX prefiltered specular cubemap, see Skybox::Result::getSpecular().
+    // Each of its levels is one roughness from 0 to 1, zero disables it.
+    int specularWidth = 0;
+    int specularLevels = 6;
+    // Importance samples per texel, at most Prefilter::MAX_SAMPLES.
+    int specularSamples = 64;
+
+    // Number of lights returned with the result, see Skybox::createLights(). Zero disables them.
+    int lightCount = 8;
+    // Directions per face edge each nebula layer is sampled at to find its light.
+    int lightSampleWidth = 16;
+    // Nebula octaves evaluated for the lights, the finer ones barely move a whole layer.
+    float lightOctaves = 4.0f;
+
+    // The quality tiers only change the cost related parameters, the same
+    // seed produces the same sky on all of them.
+    static SkyboxParams fromQuality(Quality quality);
+    static Quality parseQuality(const std::string& name);
+    static const char* toString(Quality quality);
+};
+} // namespace Space3d
@@ -0,0 +1,74 @@
+#include "TiledExport.hpp"
+#include <deque>
+#include <stdexcept>
+
+static const char TILED_MAGIC[4] = {'S', '3', 'D', 'T'};
+static const uint32_t TILED_VERSION = 1;
+
+Space3d::TiledExport::TiledExport(const Skybox& skybox, const int tileSize)
+    : skybox(skybox), tileSize(tileSize), readback(2) {
+    if (tileSize <= 0) {
+        throw std::runtime_error("Tile size must be positive");
+    }
+    for (auto& tile : scratch) {
+        tile.setTileStorage(tileSize, GL_RGB8);
+    }
+}
+
+void Space3d::TiledExport::run(const int64_t seed, const int width, const std::string& path,
+                               const SkyboxParams& params) {
+    if (width <= 0 || width % tileSize != 0) {
+        throw std::runtime_error("Cubemap width must be a multiple of the tile size");
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    writeHeader(file, width, tileSize);
+
+    const auto write = [&](const Readback::Ticket ticket) {
+        readback.read(ticket, [&](const std::vector<Readback::Image>& images) {
+            const auto& image = images.front();
+            file.write(reinterpret_cast<const char*>(image.data), static_cast<std::streamsize>(image.size));
+        });
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    };
+
+    // The layout is only a few thousand stars and a handful of nebula layers,
+    // it is shared by all tiles.
+    const auto layout = Skybox::createLayout(seed, params);
+    const int tiles = width / tileSize;
+
+    std::deque<Readback::Ticket> pending;
+    size_t index = 0;
+    for (unsigned int face = 0; face < 6; face++) {
+        for (int y = 0; y < tiles; y++) {
+            for (int x = 0; x < tiles; x++) {
+                const auto& tile = scratch[index++ % scratch.size()];
+                skybox.generateTile(layout, Skybox::tileView(face, x * tileSize, y * tileSize, tileSize, width),
+                                    Skybox::Target{GL_TEXTURE_2D, tile.get(), 0, 0, tileSize}, params);
+
+                // Write the oldest tile while the GPU works on the new one.
+                if (pending.size() == scratch.size()) {
+                    write(pending.front());
+                    pending.pop_front();
+                }
+                pending.push_back(readback.request(tile));
+            }
+        }
+    }
+
+    while (!pending.empty()) {
+        write(pending.front());
+        pending.pop_front();
+    }
+}
+
+void Space3d::TiledExport::writeHeader(std::ostream& file, const int width, const int tileSize) {
+    const uint32_t header[4] = {TILED_VERSION, static_cast<uint32_t>(width), static_cast<uint32_t>(tileSize), 3};
+    file.write(TILED_MAGIC, sizeof(TILED_MAGIC));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
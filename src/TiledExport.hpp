@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Readback.hpp"
+#include "Skybox.hpp"
+#include <array>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+namespace Space3d {
+// Generates cubemaps that fit neither into GPU nor CPU memory. Each face is rendered
+// tile by tile into a small scratch texture, read back asynchronously and appended
+// to the output file, so the peak memory depends on the tile size only.
+//
+// The file starts with the "S3DT" magic followed by four uint32 values: version,
+// face width, tile size and channel count (3, RGB8). The tiles follow, ordered by
+// face, then by tile row and tile column. Each tile is tightly packed with the first
+// row being the bottom one, the same as glReadPixels.
+class TiledExport {
+public:
+    TiledExport(const Skybox& skybox, int tileSize);
+
+    void run(int64_t seed, int width, const std::string& path, const SkyboxParams& params = SkyboxParams{});
+
+    // A whole face is a single tile when the tile size equals the width.
+    static void writeHeader(std::ostream& file, int width, int tileSize);
+
+private:
+
+    const Skybox& skybox;
+    int tileSize;
+    // Rendering a tile never waits for the readback of the previous one.
+    std::array<Skybox::Result, 2> scratch;
+    Readback readback;
+};
+} // namespace Space3d
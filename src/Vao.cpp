@@ -1,4 +1,5 @@
 #include "Vao.hpp"
+#include "GlState.hpp"
 
 Space3d::Vao::Vao() : ref(0) {
     glGenVertexArrays(1, &ref);
@@ -6,12 +7,12 @@ Space3d::Vao::Vao() : ref(0) {
 
 Space3d::Vao::~Vao() {
     if (ref) {
-        glDeleteVertexArrays(1, &ref);
+        GlState::get().deleteVertexArray(ref);
     }
 }
 
 void Space3d::Vao::bind() const {
-    glBindVertexArray(ref);
+    GlState::get().bindVertexArray(ref);
 }
 
 Space3d::Vao::Vao(Vao&& other) noexcept : ref(0) {
@@ -1,4 +1,5 @@
 #include "Vbo.hpp"
+#include "GlState.hpp"
 
 Space3d::Vbo::Vbo() : ref(0) {
     glGenBuffers(1, &ref);
@@ -6,17 +7,17 @@ Space3d::Vbo::Vbo() : ref(0) {
 
 Space3d::Vbo::~Vbo() {
     if (ref) {
-        glDeleteBuffers(1, &ref);
+        GlState::get().deleteBuffer(ref);
     }
 }
 
 void Space3d::Vbo::bufferData(const uint8_t* data, const size_t size) {
-    glBindBuffer(GL_ARRAY_BUFFER, ref);
+    GlState::get().bindBuffer(GL_ARRAY_BUFFER, ref);
     glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 }
 
 void Space3d::Vbo::bind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, ref);
+    GlState::get().bindBuffer(GL_ARRAY_BUFFER, ref);
 }
 
 Space3d::Vbo::Vbo(Vbo&& other) noexcept : ref(0) {
@@ -0,0 +1,353 @@
+#include "VirtualSkybox.hpp"
+#include "GlState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+// A plain array, display shaders in other translation units are built from it during static initialization.
+static const char VIRTUAL_SAMPLER_SOURCE[] = R"(
+uniform usampler2DArray uPageTable;
+uniform sampler2D uAtlas;
+uniform float uFaceWidth;
+uniform float uPageSize;
+uniform float uSlotSize;
+uniform float uAtlasSize;
+uniform int uMaxLevel;
+uniform float uLevelBias;
+
+// Picks the face and its texture coordinates the same way as a cubemap sampler does.
+int cubeFace(vec3 dir, out vec2 uv) {
+    vec3 a = abs(dir);
+    int face;
+    float ma;
+    vec2 sc;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = dir.x > 0.0 ? 0 : 1;
+        ma = a.x;
+        sc = dir.x > 0.0 ? vec2(-dir.z, -dir.y) : vec2(dir.z, -dir.y);
+    } else if (a.y >= a.z) {
+        face = dir.y > 0.0 ? 2 : 3;
+        ma = a.y;
+        sc = dir.y > 0.0 ? vec2(dir.x, dir.z) : vec2(dir.x, -dir.z);
+    } else {
+        face = dir.z > 0.0 ? 4 : 5;
+        ma = a.z;
+        sc = dir.z > 0.0 ? vec2(dir.x, -dir.y) : vec2(-dir.x, -dir.y);
+    }
+    uv = clamp(0.5 * (sc / ma + 1.0), 0.0, 0.99999);
+    return face;
+}
+
+// The mip level from the angle covered by a pixel, it is continuous across the face edges.
+int virtualLevel(vec3 dir) {
+    vec3 d = normalize(dir);
+    float angle = max(length(dFdx(d)), length(dFdy(d)));
+    float level = log2(max(angle * uFaceWidth * 0.5, 1e-6)) + uLevelBias;
+    return int(clamp(floor(level), 0.0, float(uMaxLevel)));
+}
+
+ivec2 virtualPage(vec2 uv, int level) {
+    float pages = uFaceWidth / uPageSize / exp2(float(level));
+    return ivec2(uv * pages);
+}
+
+vec3 sampleVirtualSkybox(vec3 dir) {
+    vec2 uv;
+    int face = cubeFace(dir, uv);
+    int level = virtualLevel(dir);
+    uvec4 entry = texelFetch(uPageTable, ivec3(virtualPage(uv, level), face), level);
+
+    // The entry may point to a coarser page that covers this one.
+    float pages = uFaceWidth / uPageSize / exp2(float(entry.z));
+    vec2 texel = vec2(entry.xy) * uSlotSize + 1.0 + fract(uv * pages) * uPageSize;
+    return textureLod(uAtlas, texel / uAtlasSize, 0.0).rgb;
+}
+)";
+
+static const std::string VIRTUAL_FEEDBACK_FRAG = std::string("#version 330 core\n") + VIRTUAL_SAMPLER_SOURCE + R"(
+in vec3 v_texCoords;
+
+out uvec4 fragmentPage;
+
+void main() {
+    vec2 uv;
+    int face = cubeFace(v_texCoords, uv);
+    int level = virtualLevel(v_texCoords);
+    fragmentPage = uvec4(uvec2(virtualPage(uv, level)), uint(face), uint(level));
+}
+)";
+
+static const std::string VIRTUAL_FEEDBACK_VERT = R"(#version 330 core
+layout(location = 0) in vec3 position;
+
+out vec3 v_texCoords;
+
+uniform mat4 modelMatrix;
+uniform mat4 transformationProjectionMatrix;
+
+void main() {
+    v_texCoords = position;
+    vec4 worldPos = modelMatrix * vec4(position, 1.0);
+    gl_Position = transformationProjectionMatrix * worldPos;
+}
+)";
+
+// The feedback is rendered at a fraction of the screen, a page is far bigger than a pixel.
+static const int FEEDBACK_SIZE = 128;
+static const uint16_t FEEDBACK_EMPTY = 0xFFFF;
+
+Space3d::VirtualSkybox::VirtualSkybox(const Skybox& skybox, const int64_t seed, const int faceWidth,
+                                      const int pageSize, const int slotsPerSide, const SkyboxParams& params,
+                                      const ProgramCache* cache)
+    : skybox(skybox), params(params), layout(Skybox::createLayout(seed, params)), faceWidth(faceWidth),
+      pageSize(pageSize), slotsPerSide(slotsPerSide), levels(1), frame(0), pageTable(0),
+      shaderFeedback(VIRTUAL_FEEDBACK_VERT, VIRTUAL_FEEDBACK_FRAG, std::nullopt, cache), readback(2), dirty(true) {
+
+    const int pagesPerSide = pageSize > 0 ? faceWidth / pageSize : 0;
+    if (pagesPerSide <= 0 || faceWidth % pageSize != 0 || (pagesPerSide & (pagesPerSide - 1)) != 0) {
+        throw std::runtime_error("Virtual skybox width must be a power of two multiple of the page size");
+    }
+    // The pinned pages take six slots, the rest is for the pages on screen.
+    if (slotsPerSide * slotsPerSide <= 6) {
+        throw std::runtime_error("Virtual skybox atlas is too small");
+    }
+    while ((pagesPerSide >> levels) > 0) {
+        levels++;
+    }
+
+    // Each page has a one texel border so that bilinear filtering does not bleed into its neighbours.
+    const int slotSize = pageSize + 2;
+    atlas.setTileStorage(slotsPerSide * slotSize, GL_RGB8);
+    scratch.setTileStorage(slotSize, GL_RGB8);
+    feedback.setTileStorage(FEEDBACK_SIZE, GL_RGBA16UI);
+
+    glGenTextures(1, &pageTable);
+    GlState::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, pageTable);
+    for (int level = 0; level < levels; level++) {
+        const int size = pagesPerSide >> level;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA16UI, size, size, 6, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT,
+                     nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    for (int slot = slotsPerSide * slotsPerSide - 1; slot >= 0; slot--) {
+        freeSlots.push_back(slot);
+    }
+
+    // The coarsest level is the fallback for everything else.
+    for (unsigned int face = 0; face < 6; face++) {
+        const auto key = createKey(face, levels - 1, 0, 0);
+        int slot;
+        allocateSlot(slot);
+        generatePage(key, slot);
+        pages[key] = Page{slot, 0, true, lru.end()};
+    }
+    updatePageTable();
+}
+
+Space3d::VirtualSkybox::~VirtualSkybox() {
+    if (pageTable) {
+        GlState::get().deleteTexture(pageTable);
+    }
+}
+
+const std::string& Space3d::VirtualSkybox::samplerSource() {
+    static const std::string source = VIRTUAL_SAMPLER_SOURCE;
+    return source;
+}
+
+uint64_t Space3d::VirtualSkybox::createKey(const unsigned int face, const int level, const int x, const int y) {
+    return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(face) << 40) |
+           (static_cast<uint64_t>(y) << 20) | static_cast<uint64_t>(x);
+}
+
+void Space3d::VirtualSkybox::renderFeedback(const Vao& cube, const glm::mat4& modelMatrix,
+                                            const glm::mat4& transformationProjection, const float screenHeight) {
+    // The GPU is behind, skip this frame rather than wait for it.
+    if (pending.size() >= 2) {
+        return;
+    }
+
+    fbo.bind();
+    GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedback.get(), 0);
+    static const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+    GlState::get().viewport(0, 0, FEEDBACK_SIZE, FEEDBACK_SIZE);
+
+    const GLuint empty[] = {FEEDBACK_EMPTY, FEEDBACK_EMPTY, FEEDBACK_EMPTY, FEEDBACK_EMPTY};
+    glClearBufferuiv(GL_COLOR, 0, empty);
+
+    glDisable(GL_BLEND);
+    shaderFeedback.use();
+    shaderFeedback.setMat4("modelMatrix", modelMatrix);
+    shaderFeedback.setMat4("transformationProjectionMatrix", transformationProjection);
+    shaderFeedback.setFloat("uFaceWidth", static_cast<float>(faceWidth));
+    shaderFeedback.setFloat("uPageSize", static_cast<float>(pageSize));
+    shaderFeedback.setInt("uMaxLevel", levels - 1);
+    // A feedback pixel covers more of the sky than a screen pixel.
+    shaderFeedback.setFloat("uLevelBias", -std::log2(std::max(screenHeight, 1.0f) / FEEDBACK_SIZE));
+    cube.bind();
+    shaderFeedback.drawArrays(GL_TRIANGLES, 6 * 6);
+    glEnable(GL_BLEND);
+
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    pending.push_back(readback.request(feedback));
+}
+
+void Space3d::VirtualSkybox::update(const size_t budget) {
+    frame++;
+
+    // The feedback is consumed once the GPU is done with it, a frame or two late.
+    std::vector<uint64_t> requests;
+    if (!pending.empty() && readback.isReady(pending.front())) {
+        readback.read(pending.front(), [&](const std::vector<Readback::Image>& images) {
+            const auto* texels = reinterpret_cast<const uint16_t*>(images.front().data);
+            const size_t count = images.front().size / (4 * sizeof(uint16_t));
+
+            std::unordered_set<uint64_t> seen;
+            for (size_t i = 0; i < count; i++) {
+                const uint16_t* texel = &texels[i * 4];
+                if (texel[3] == FEEDBACK_EMPTY || texel[3] >= levels || texel[2] >= 6) {
+                    continue;
+                }
+
+                const auto key = createKey(texel[2], texel[3], texel[0], texel[1]);
+                if (!seen.insert(key).second) {
+                    continue;
+                }
+
+                auto it = pages.find(key);
+                if (it == pages.end()) {
+                    requests.push_back(key);
+                } else if (!it->second.pinned) {
+                    it->second.frame = frame;
+                    lru.splice(lru.begin(), lru, it->second.lru);
+                }
+            }
+        });
+        pending.pop_front();
+    }
+
+    // Coarse pages cover more of the screen and are the fallback of the finer ones.
+    std::sort(requests.begin(), requests.end(),
+              [](const uint64_t a, const uint64_t b) { return (a >> 48) > (b >> 48); });
+    if (requests.size() > budget) {
+        requests.resize(budget);
+    }
+
+    for (const auto key : requests) {
+        int slot;
+        if (!allocateSlot(slot)) {
+            break;
+        }
+        generatePage(key, slot);
+        lru.push_front(key);
+        pages[key] = Page{slot, frame, false, lru.begin()};
+        dirty = true;
+    }
+
+    if (dirty) {
+        updatePageTable();
+    }
+}
+
+bool Space3d::VirtualSkybox::allocateSlot(int& slot) {
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        return true;
+    }
+
+    // Evict the least recently used page, unless everything in the atlas is on screen.
+    if (lru.empty()) {
+        return false;
+    }
+    auto it = pages.find(lru.back());
+    if (it->second.frame >= frame) {
+        return false;
+    }
+    slot = it->second.slot;
+    pages.erase(it);
+    lru.pop_back();
+    dirty = true;
+    return true;
+}
+
+void Space3d::VirtualSkybox::generatePage(const uint64_t key, const int slot) {
+    const int x = static_cast<int>(key & 0xFFFFF);
+    const int y = static_cast<int>((key >> 20) & 0xFFFFF);
+    const auto face = static_cast<unsigned int>((key >> 40) & 0xFF);
+    const int level = static_cast<int>(key >> 48);
+    const int slotSize = pageSize + 2;
+
+    // The page and its border, rendered with the detail of its mip level.
+    const auto view = Skybox::tileView(face, x * pageSize - 1, y * pageSize - 1, slotSize, faceWidth >> level);
+    skybox.generateTile(layout, view, Skybox::Target{GL_TEXTURE_2D, scratch.get(), 0, 0, slotSize}, params);
+
+    fbo.bind();
+    GlState::get().framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scratch.get(), 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    atlas.bind();
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slotsPerSide) * slotSize, (slot / slotsPerSide) * slotSize, 0, 0,
+                        slotSize, slotSize);
+    GlState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Space3d::VirtualSkybox::updatePageTable() {
+    // Top down, a missing page takes the entry of its parent.
+    std::vector<std::vector<uint16_t>> table(levels);
+    for (int level = levels - 1; level >= 0; level--) {
+        const int size = (faceWidth / pageSize) >> level;
+        auto& entries = table[level];
+        entries.resize(static_cast<size_t>(size) * size * 6 * 4);
+
+        for (unsigned int face = 0; face < 6; face++) {
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                    uint16_t* entry = &entries[((face * size + y) * size + x) * 4];
+                    auto it = pages.find(createKey(face, level, x, y));
+                    if (it != pages.end()) {
+                        entry[0] = static_cast<uint16_t>(it->second.slot % slotsPerSide);
+                        entry[1] = static_cast<uint16_t>(it->second.slot / slotsPerSide);
+                        entry[2] = static_cast<uint16_t>(level);
+                        entry[3] = 0;
+                    } else {
+                        const int parentSize = size / 2;
+                        const uint16_t* parent =
+                            &table[level + 1][((face * parentSize + y / 2) * parentSize + x / 2) * 4];
+                        std::copy(parent, parent + 4, entry);
+                    }
+                }
+            }
+        }
+    }
+
+    GlState::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, pageTable);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < levels; level++) {
+        const int size = (faceWidth / pageSize) >> level;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, size, size, 6, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT,
+                        table[level].data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    dirty = false;
+}
+
+void Space3d::VirtualSkybox::bind(const Shader& shader, const GLuint pageTableUnit, const GLuint atlasUnit) const {
+    GlState::get().bindTexture(pageTableUnit, GL_TEXTURE_2D_ARRAY, pageTable);
+    atlas.bind(atlasUnit);
+
+    shader.use();
+    shader.setInt("uPageTable", static_cast<int>(pageTableUnit));
+    shader.setInt("uAtlas", static_cast<int>(atlasUnit));
+    shader.setFloat("uFaceWidth", static_cast<float>(faceWidth));
+    shader.setFloat("uPageSize", static_cast<float>(pageSize));
+    shader.setFloat("uSlotSize", static_cast<float>(pageSize + 2));
+    shader.setFloat("uAtlasSize", static_cast<float>(atlas.getWidth()));
+    shader.setInt("uMaxLevel", levels - 1);
+    shader.setFloat("uLevelBias", 0.0f);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Fbo.hpp"
+#include "Readback.hpp"
+#include "Shader.hpp"
+#include "Skybox.hpp"
+#include "Vao.hpp"
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace Space3d {
+// A skybox far larger than what fits into GPU memory, generated only where the
+// camera looks. Every face and mip level is split into pages, and only the pages
+// requested by the feedback pass are generated into a fixed size atlas. A page
+// table maps each page to its atlas slot, or to the closest resident coarser page.
+// The single page per face of the coarsest level is always resident.
+class VirtualSkybox {
+public:
+    VirtualSkybox(const Skybox& skybox, int64_t seed, int faceWidth, int pageSize = 128, int slotsPerSide = 16,
+                  const SkyboxParams& params = SkyboxParams{}, const ProgramCache* cache = nullptr);
+    VirtualSkybox(const VirtualSkybox& other) = delete;
+    ~VirtualSkybox();
+
+    VirtualSkybox& operator=(const VirtualSkybox& other) = delete;
+
+    // Renders the given skybox cube into a small buffer that records the page each
+    // pixel would sample. The result is read back asynchronously by update().
+    void renderFeedback(const Vao& cube, const glm::mat4& modelMatrix, const glm::mat4& transformationProjection,
+                        float screenHeight);
+    // Consumes the finished feedback and generates at most the budget of missing pages,
+    // coarse pages first. Least recently used pages are evicted when the atlas is full.
+    void update(size_t budget = 4);
+    // Binds the page table and the atlas and sets the uniforms used by samplerSource().
+    void bind(const Shader& shader, GLuint pageTableUnit, GLuint atlasUnit) const;
+
+    size_t getResidentPages() const {
+        return pages.size();
+    }
+
+    // GLSL uniforms and the sampleVirtualSkybox(direction) function for display shaders.
+    static const std::string& samplerSource();
+
+private:
+    struct Page {
+        int slot;
+        // The last frame the feedback asked for the page.
+        uint64_t frame;
+        bool pinned;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    static uint64_t createKey(unsigned int face, int level, int x, int y);
+    bool allocateSlot(int& slot);
+    void generatePage(uint64_t key, int slot);
+    void updatePageTable();
+
+    const Skybox& skybox;
+    SkyboxParams params;
+    Skybox::Layout layout;
+    int faceWidth;
+    int pageSize;
+    int slotsPerSide;
+    int levels;
+    uint64_t frame;
+
+    Skybox::Result atlas;
+    Skybox::Result scratch;
+    Skybox::Result feedback;
+    GLuint pageTable;
+    Shader shaderFeedback;
+    Fbo fbo;
+    Readback readback;
+    std::deque<Readback::Ticket> pending;
+
+    std::vector<int> freeSlots;
+    std::unordered_map<uint64_t, Page> pages;
+    // Most recently used first, the pinned coarsest pages are not in the list.
+    std::list<uint64_t> lru;
+    bool dirty;
+};
+} // namespace Space3d
@@ -2,8 +2,11 @@
 #include <glad/glad.h> // Needs to be first
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/matrix.hpp>
 #include "Window.hpp"
+#include "GlState.hpp"
 #include "Skybox.hpp"
+#include "VirtualSkybox.hpp"
 #include <exception>
 #include <iostream>
 #include <random>
@@ -22,6 +25,39 @@ void main() {
 }
 )";
 
+// Same as above, but for an octahedral map in a 2D texture.
+static const std::string SKYBOX_OCTAHEDRAL_SHADER_FRAG = std::string("#version 330 core\n") +
+                                                         Space3d::Skybox::octahedralSource() + R"(
+in vec3 v_texCoords;
+
+out vec4 fragmentColor;
+
+uniform sampler2D skyboxTexture;
+
+void main() {
+    // The folds of the map break the screen space derivatives of the texture coordinates,
+    // the level of detail follows the change of the direction instead.
+    vec3 dir = normalize(v_texCoords);
+    float footprint = max(length(dFdx(dir)), length(dFdy(dir)));
+    float lod = log2(max(footprint * float(textureSize(skyboxTexture, 0).x) * 0.5, 1.0));
+    vec3 emissive = textureLod(skyboxTexture, octahedralEncode(dir) * 0.5 + 0.5, lod).rgb;
+    fragmentColor = vec4(emissive, 1.0);
+}
+)";
+
+// Same as the first one, but samples the virtual skybox through its page table.
+static const std::string SKYBOX_VIRTUAL_SHADER_FRAG = "#version 330 core\n" +
+                                                      Space3d::VirtualSkybox::samplerSource() + R"(
+in vec3 v_texCoords;
+
+out vec4 fragmentColor;
+
+void main() {
+    vec3 emissive = sampleVirtualSkybox(v_texCoords);
+    fragmentColor = vec4(emissive, 1.0);
+}
+)";
+
 static const std::string SKYBOX_SHADER_VERT = R"(#version 330 core
 layout(location = 0) in vec3 position;
 
@@ -62,39 +98,25 @@ static const float SKYBOX_VERTICES[] = {
 #define M_PI 3.14159265358979323846
 #endif
 
-Space3d::Window::Window() : window(nullptr), angle(0.0f) {
+// An octahedral map needs about 2.28 times the face width for the same angular resolution.
+static int skyboxWidth(const Space3d::SkyboxParams& params) {
+    return params.mapping == Space3d::SkyboxParams::Mapping::Octahedral ? 2048 : 1024;
 }
 
-Space3d::Window::~Window() {
-    if (window) {
-        glfwDestroyWindow(window);
-        glfwTerminate();
-    }
+Space3d::Window::Window(const SkyboxParams& params, const int virtualWidth, const bool lazy, const bool animated,
+                        const int64_t seed)
+    : params(params), programCache("shader-cache"), angle(0.0f), seed(seed), virtualWidth(virtualWidth), lazy(lazy),
+      animated(animated) {
 }
 
-void Space3d::Window::run() {
-    glfwSetErrorCallback(errorCallback);
-
-    if (!glfwInit()) {
-        throw std::runtime_error("Failed to initialize glfw");
-    }
-
-    // Basic GLFW window stuff
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+Space3d::Window::~Window() = default;
 
-    window = glfwCreateWindow(1280, 720, "Space 3D", nullptr, nullptr);
-    if (!window) {
-        glfwTerminate();
-        throw std::runtime_error("Failed to create glfw window");
-    }
+void Space3d::Window::run() {
+    context = std::make_unique<Context>(1280, 720, "Space 3D", true);
+    GLFWwindow* window = context->get();
 
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, keyCallback);
-
-    glfwMakeContextCurrent(window);
-    gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
     glfwSwapInterval(1);
 
     // You need to enable these
@@ -103,10 +125,15 @@ void Space3d::Window::run() {
     glEnable(GL_BLEND);
 
     // This shader will be used to render the skybox texture (not to generate it!)
-    Shader skyboxShader(SKYBOX_SHADER_VERT, SKYBOX_SHADER_FRAG, std::nullopt);
+    Shader skyboxShader(SKYBOX_SHADER_VERT, SKYBOX_SHADER_FRAG, std::nullopt, &programCache);
     skyboxShader.use();
     skyboxShader.setInt("skyboxTexture", 0);
-    skyboxShader.setMat4("modelMatrix", glm::scale(glm::mat4x4(1.0f), glm::vec3{100.0f}));
+    const auto model = glm::scale(glm::mat4x4(1.0f), glm::vec3{100.0f});
+    skyboxShader.setMat4("modelMatrix", model);
+    Shader octahedralShader(SKYBOX_SHADER_VERT, SKYBOX_OCTAHEDRAL_SHADER_FRAG, std::nullopt, &programCache);
+    octahedralShader.use();
+    octahedralShader.setInt("skyboxTexture", 0);
+    octahedralShader.setMat4("modelMatrix", model);
     const auto projection = glm::perspective(static_cast<float>(M_PI) / 2.0f, 1.0f, 0.1f, 1000.0f);
 
     // This is just a simple box skybox
@@ -121,40 +148,79 @@ void Space3d::Window::run() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
     // Create the skybox generator instance and create a new skybox
-    // with seed 12345LL and texture size 1024x1024 (6 sides).
-    skybox = std::make_unique<Skybox>();
-    result = skybox->generate(12345LL, 1024);
+    // with the initial seed and texture size 1024x1024 (6 sides).
+    skybox = std::make_unique<Skybox>(&programCache);
+    skybox->setResultPool(&pool);
+
+    // Only the pages of a virtual skybox that are on screen are ever generated.
+    std::unique_ptr<Shader> virtualShader;
+    if (virtualWidth > 0) {
+        virtualShader =
+            std::make_unique<Shader>(SKYBOX_SHADER_VERT, SKYBOX_VIRTUAL_SHADER_FRAG, std::nullopt, &programCache);
+        virtualShader->use();
+        virtualShader->setMat4("modelMatrix", model);
+        virtualSkybox = std::make_unique<VirtualSkybox>(*skybox, seed, virtualWidth, 128, 16, params, &programCache);
+    } else if (lazy) {
+        lazySkybox = std::make_unique<LazySkybox>(*skybox, seed, 1024, params);
+    } else if (animated) {
+        animatedSkybox = std::make_unique<AnimatedSkybox>(*skybox, seed, 1024, params, 256, 0.05f, &programCache);
+    } else {
+        result = skybox->generate(seed, skyboxWidth(params), params);
+    }
 
     while (!glfwWindowShouldClose(window)) {
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
 
-        glViewport(0, 0, width, height);
+        const auto transformation = glm::rotate(glm::mat4x4(1.0f), angle, glm::vec3{0.0f, 1.0f, 0.0f});
+        angle += 0.001f;
+
+        if (virtualSkybox) {
+            virtualSkybox->renderFeedback(vaoSkybox, model, projection * transformation, static_cast<float>(height));
+            virtualSkybox->update();
+        }
+
+        // One full resolution face per frame, starting with the one in front of the camera.
+        if (lazySkybox && !lazySkybox->isComplete()) {
+            const auto forward = glm::inverse(transformation) * glm::vec4{0.0f, 0.0f, -1.0f, 0.0f};
+            lazySkybox->update(glm::vec3{forward});
+        }
+
+        // Four of the 96 tiles of the next keyframe per frame.
+        if (animatedSkybox) {
+            animatedSkybox->update();
+        }
+
+        GlState::get().viewport(0, 0, width, height);
         glClear(GL_COLOR_BUFFER_BIT);
 
         // Default blending
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GlState::get().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
 
-        const auto transformation = glm::rotate(glm::mat4x4(1.0f), angle, glm::vec3{0.0f, 1.0f, 0.0f});
-        angle += 0.001f;
-
         // Render the skybox on the screen
-        skyboxShader.use();
-        vaoSkybox.bind();
-        result.value().bind();
-        skyboxShader.setMat4("transformationProjectionMatrix", projection * transformation);
-        skyboxShader.drawArrays(GL_TRIANGLES, 6 * 6);
+        if (virtualSkybox) {
+            virtualSkybox->bind(*virtualShader, 0, 1);
+            vaoSkybox.bind();
+            virtualShader->setMat4("transformationProjectionMatrix", projection * transformation);
+            virtualShader->drawArrays(GL_TRIANGLES, 6 * 6);
+        } else {
+            const auto& sky = lazySkybox       ? lazySkybox->getResult()
+                              : animatedSkybox ? animatedSkybox->getResult()
+                                               : result.value();
+            const auto& shader = sky.getTarget() == GL_TEXTURE_2D ? octahedralShader : skyboxShader;
+            shader.use();
+            vaoSkybox.bind();
+            sky.bind();
+            shader.setMat4("transformationProjectionMatrix", projection * transformation);
+            shader.drawArrays(GL_TRIANGLES, 6 * 6);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 }
 
-void Space3d::Window::errorCallback(const int error, const char* description) {
-    std::cerr << "error: " << error << " description: " << description << std::endl;
-}
-
 void Space3d::Window::keyCallback(GLFWwindow* window, const int key, const int scancode, const int action,
                                   const int mods) {
     (void)scancode;
@@ -166,18 +232,23 @@ void Space3d::Window::keyCallback(GLFWwindow* window, const int key, const int s
         // Will create 1024x1024 cubemap texture.
         const auto seed = std::random_device{}();
         std::cout << "new seed: " << seed << std::endl;
-        self.result = self.skybox->generate(seed, 1024);
-    }
-}
-
-int main(const int argc, char** argv) {
-    using namespace Space3d;
-    try {
-        Window window;
-        window.run();
-        return EXIT_SUCCESS;
-    } catch (std::exception& e) {
-        std::cerr << e.what() << std::endl;
-        return EXIT_FAILURE;
+        if (self.virtualSkybox) {
+            self.virtualSkybox.reset();
+            self.virtualSkybox =
+                std::make_unique<VirtualSkybox>(*self.skybox, seed, self.virtualWidth, 128, 16, self.params,
+                                                &self.programCache);
+            return;
+        }
+        if (self.lazySkybox) {
+            self.lazySkybox = std::make_unique<LazySkybox>(*self.skybox, seed, 1024, self.params);
+            return;
+        }
+        if (self.animatedSkybox) {
+            self.animatedSkybox =
+                std::make_unique<AnimatedSkybox>(*self.skybox, seed, 1024, self.params, 256, 0.05f, &self.programCache);
+            return;
+        }
+        self.pool.recycle(std::move(self.result.value()));
+        self.result = self.skybox->generate(seed, skyboxWidth(self.params), self.params);
     }
 }
@@ -1,24 +1,46 @@
 #pragma once
 
+#include "AnimatedSkybox.hpp"
+#include "Context.hpp"
+#include "LazySkybox.hpp"
+#include "ResultPool.hpp"
 #include "Skybox.hpp"
+#include "VirtualSkybox.hpp"
 #include <GLFW/glfw3.h>
 
 namespace Space3d {
 class Window {
 public:
-    Window();
+    // A non-zero virtual width displays a virtual skybox of that face width instead of a cubemap.
+    // In the lazy mode a new skybox starts as a placeholder and its faces are refined per frame.
+    // In the animated mode the nebulas keep evolving, a few tiles are rendered per frame.
+    // The seed is the one of the first skybox.
+    explicit Window(const SkyboxParams& params, int virtualWidth = 0, bool lazy = false, bool animated = false,
+                    int64_t seed = 12345);
     ~Window();
 
     void run();
 
 private:
-    static void errorCallback(int error, const char* description);
     static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
-    GLFWwindow* window;
+    // Declared first, the OpenGL objects below must be destroyed before the context.
+    std::unique_ptr<Context> context;
+    SkyboxParams params;
+    // Linked shader programs are cached in the working directory between runs.
+    ProgramCache programCache;
+    // The previous skybox is recycled when a new one is generated.
+    ResultPool pool;
     float angle;
+    int64_t seed;
 
     std::unique_ptr<Skybox> skybox;
     std::optional<Skybox::Result> result;
+    int virtualWidth;
+    std::unique_ptr<VirtualSkybox> virtualSkybox;
+    bool lazy;
+    std::unique_ptr<LazySkybox> lazySkybox;
+    bool animated;
+    std::unique_ptr<AnimatedSkybox> animatedSkybox;
 };
 } // namespace Space3d